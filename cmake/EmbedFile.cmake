@@ -0,0 +1,23 @@
+# Writes the bytes of INPUT into OUTPUT as a constexpr byte array named SYMBOL. The array is
+# 4-byte aligned and padded to a multiple of 4 bytes, since SPIR-V is read as 32-bit words.
+# Usage: cmake -DINPUT=<file> -DOUTPUT=<header> -DSYMBOL=<name> -P EmbedFile.cmake
+
+file(READ "${INPUT}" CONTENTS HEX)
+get_filename_component(INPUT_NAME "${INPUT}" NAME)
+
+string(LENGTH "${CONTENTS}" HEX_LENGTH)
+math(EXPR PADDING "(4 - (${HEX_LENGTH} / 2) % 4) % 4")
+
+if (PADDING GREATER 0)
+	string(REPEAT "00" ${PADDING} PADDING_BYTES)
+	string(APPEND CONTENTS "${PADDING_BYTES}")
+endif()
+
+# Sixteen bytes per line.
+string(REPEAT "[0-9a-f][0-9a-f]" 16 LINE_PATTERN)
+string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n" BYTES "${CONTENTS}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " BYTES "${BYTES}")
+string(REGEX REPLACE ", \n" ",\n    " BYTES "${BYTES}")
+string(STRIP "${BYTES}" BYTES)
+
+file(WRITE "${OUTPUT}" "// Generated from ${INPUT_NAME}, do not edit.\n#pragma once\n\n#include <cstdint>\n\nalignas(4) constexpr uint8_t ${SYMBOL}[] = {\n    ${BYTES}\n};\n")
@@ -1,5 +1,9 @@
 #include <print>
 #include "SDL3/SDL.h"
+#include "Common/misc.h"
+#include "shaders/vertex_shader.spv.h"
+#include "shaders/fragment_shader.spv.h"
+#include "shaders/fragment_shader2.spv.h"
 
 float _vertices[] = {
     -1.0f, -0.5f, 0.0f,
@@ -47,176 +51,46 @@ int main()
         return -1;
     }
 
-    size_t vertexShaderCodeSize;
-    void* vertexShaderCode = SDL_LoadFile("shaders/vertex_shader.spv", &vertexShaderCodeSize);
-
-    if (vertexShaderCode == NULL)
-    {
-        SDL_Log("Failed to load vertex shader");
-        return -1;
-    }
-
-    SDL_GPUShaderCreateInfo vertexShaderInfo = {
-        .code_size = vertexShaderCodeSize,
-        .code = (uint8_t*)vertexShaderCode,
-        .entrypoint = "main",
-        .format = SDL_GPU_SHADERFORMAT_SPIRV,
-        .stage = SDL_GPU_SHADERSTAGE_VERTEX,
-        .num_samplers = 0,
-        .num_storage_textures = 0,
-        .num_storage_buffers = 0,
-        .num_uniform_buffers = 0
-    };
-
-    SDL_GPUShader* vertexShader = SDL_CreateGPUShader(graphicsDevice, &vertexShaderInfo);
-
-    if (vertexShader == NULL)
-    {
-        SDL_Log("Failed to create vertex shader: %s", SDL_GetError());
-        return -1;
-    }
-
-    SDL_free(vertexShaderCode);
-
-    size_t fragmentShaderCodeSize;
-    void* fragmentShaderCode = SDL_LoadFile("shaders/fragment_shader.spv", &fragmentShaderCodeSize);
-
-    if (fragmentShaderCode == NULL)
-    {
-        SDL_Log("Failed to load fragment shader");
-        return -1;
-    }
-
-    SDL_GPUShaderCreateInfo fragmentShaderInfo = {
-        .code_size = fragmentShaderCodeSize,
-        .code = (uint8_t*)fragmentShaderCode,
-        .entrypoint = "main",
-        .format = SDL_GPU_SHADERFORMAT_SPIRV,
-        .stage = SDL_GPU_SHADERSTAGE_FRAGMENT,
-        .num_samplers = 0,
-        .num_storage_textures = 0,
-        .num_storage_buffers = 0,
-        .num_uniform_buffers = 0
-    };
-
-    SDL_GPUShader* fragmentShader = SDL_CreateGPUShader(graphicsDevice, &fragmentShaderInfo);
-
-    if (fragmentShader == NULL)
-    {
-        SDL_Log("Failed to create fragment shader: %s", SDL_GetError());
-        return -1;
-    }
-
-    SDL_free(fragmentShaderCode);
-
-    size_t fragmentShaderCodeSize2;
-    void* fragmentShaderCode2 = SDL_LoadFile("shaders/fragment_shader2.spv", &fragmentShaderCodeSize2);
-
-    if (fragmentShaderCode2 == NULL)
-    {
-        SDL_Log("Failed to load fragment shader2");
-        return -1;
-    }
-
-    SDL_GPUShaderCreateInfo fragmentShaderInfo2 = {
-        .code_size = fragmentShaderCodeSize2,
-        .code = (uint8_t*)fragmentShaderCode2,
-        .entrypoint = "main",
-        .format = SDL_GPU_SHADERFORMAT_SPIRV,
-        .stage = SDL_GPU_SHADERSTAGE_FRAGMENT,
-        .num_samplers = 0,
-        .num_storage_textures = 0,
-        .num_storage_buffers = 0,
-        .num_uniform_buffers = 0
-    };
-
-    SDL_GPUShader* fragmentShader2 = SDL_CreateGPUShader(graphicsDevice, &fragmentShaderInfo2);
-
-    if (fragmentShader2 == NULL)
-    {
-        SDL_Log("Failed to create fragment shader 2: %s", SDL_GetError());
-        return -1;
-    }
-
-    SDL_free(fragmentShaderCode2);
-
-    SDL_GPUVertexBufferDescription vertexBufferDescriptions[1];
-    vertexBufferDescriptions[0] = {
-        .slot = 0,
-        .pitch = 3 * sizeof(float),
-        .input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX,
-        .instance_step_rate = 0,
-    };
-
-    SDL_GPUVertexAttribute vertexAttributes[1];
-    vertexAttributes[0] = {
-        .location = 0,
-        .buffer_slot = 0,
-        .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-        .offset = 0
-    };
-
-    SDL_GPUColorTargetDescription colorTargetDescriptions[1];
-    colorTargetDescriptions[0] = {
-        .format = SDL_GetGPUSwapchainTextureFormat(graphicsDevice, window)
-    };
-    
-    SDL_GPUGraphicsPipelineCreateInfo pipelineInfo = {
-        .vertex_shader = vertexShader,
-        .fragment_shader = fragmentShader,
-        .vertex_input_state = {
-            .vertex_buffer_descriptions = vertexBufferDescriptions,
-            .num_vertex_buffers = 1,
-            .vertex_attributes = vertexAttributes,
-            .num_vertex_attributes = 1,
-        },
-        .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
-        .target_info = {
-            .color_target_descriptions = colorTargetDescriptions,
-            .num_color_targets = 1,
+    PipelineCreateInfo pipelineInfo = {
+        .VertexBufferDescriptions = { { .Slot = 0, .Pitch = 3 * sizeof(float) } },
+        .VertexAttributes = {
+            SDL_GPUVertexAttribute{ .location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 0 },
         },
+        .Blend = BlendMode::Opaque,
     };
 
-    SDL_GPUGraphicsPipeline* pipeline = SDL_CreateGPUGraphicsPipeline(graphicsDevice, &pipelineInfo);
-
-    if (pipeline == NULL)
-    {
-        SDL_Log("Failed to create graphics pipeline: %s", SDL_GetError());
-        return -1;
-    }
-
-    SDL_GPUGraphicsPipelineCreateInfo pipelineInfo2 = {
-        .vertex_shader = vertexShader,
-        .fragment_shader = fragmentShader2,
-        .vertex_input_state = {
-            .vertex_buffer_descriptions = vertexBufferDescriptions,
-            .num_vertex_buffers = 1,
-            .vertex_attributes = vertexAttributes,
-            .num_vertex_attributes = 1,
+    // Both pipelines share the vertex shader, which the batch creates only once.
+    std::vector<PipelineBatchEntry> pipelineEntries = {
+        {
+            .VertexShaderCode = VertexShaderSpv,
+            .VertexShaderCodeSize = sizeof(VertexShaderSpv),
+            .VertexShaderInfo = { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX },
+            .FragmentShaderCode = FragmentShaderSpv,
+            .FragmentShaderCodeSize = sizeof(FragmentShaderSpv),
+            .FragmentShaderInfo = { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT },
+            .PipelineInfo = pipelineInfo,
         },
-        .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
-        .target_info = {
-            .color_target_descriptions = colorTargetDescriptions,
-            .num_color_targets = 1,
+        {
+            .VertexShaderCode = VertexShaderSpv,
+            .VertexShaderCodeSize = sizeof(VertexShaderSpv),
+            .VertexShaderInfo = { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX },
+            .FragmentShaderCode = FragmentShader2Spv,
+            .FragmentShaderCodeSize = sizeof(FragmentShader2Spv),
+            .FragmentShaderInfo = { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT },
+            .PipelineInfo = pipelineInfo,
         },
     };
 
-    SDL_GPUGraphicsPipeline* pipeline2 = SDL_CreateGPUGraphicsPipeline(graphicsDevice, &pipelineInfo2);
+    PipelineBatch pipelineBatch;
 
-    if (pipeline2 == NULL)
+    if (!pipelineBatch.Compile(graphicsDevice, window, pipelineEntries))
     {
-        SDL_Log("Failed to create graphics pipeline 2: %s", SDL_GetError());
+        SDL_Log("Failed to create graphics pipelines: %s", SDL_GetError());
         return -1;
     }
 
-    SDL_ReleaseGPUShader(graphicsDevice, vertexShader);
-    vertexShader = NULL;
-
-    SDL_ReleaseGPUShader(graphicsDevice, fragmentShader);
-    fragmentShader = NULL;
-
-    SDL_ReleaseGPUShader(graphicsDevice, fragmentShader2);
-    fragmentShader2 = NULL;
+    SDL_GPUGraphicsPipeline* pipeline = pipelineBatch.GetPipeline(0)->GetHandle();
+    SDL_GPUGraphicsPipeline* pipeline2 = pipelineBatch.GetPipeline(1)->GetHandle();
 
     SDL_GPUBufferCreateInfo vertexBufferInfo = {
         .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
@@ -278,8 +152,7 @@ int main()
 
     SDL_ReleaseGPUBuffer(graphicsDevice, vertexBuffer);
     SDL_ReleaseGPUBuffer(graphicsDevice, vertexBuffer2);
-    SDL_ReleaseGPUGraphicsPipeline(graphicsDevice, pipeline);
-    SDL_ReleaseGPUGraphicsPipeline(graphicsDevice, pipeline2);
+    pipelineBatch.Release();
     SDL_ReleaseWindowFromGPUDevice(graphicsDevice, window);
     SDL_DestroyGPUDevice(graphicsDevice);
     SDL_DestroyWindow(window);
@@ -2,6 +2,8 @@
 #include <algorithm>
 #include "SDL3/SDL.h"
 #include "Common/misc.h"
+#include "shaders/vertex_shader.spv.h"
+#include "shaders/fragment_shader.spv.h"
 
 float _vertices[] = {
     -0.5f, -0.5f, 0.0f,     1.0f, 0.0f, 0.0f,
@@ -44,7 +46,7 @@ int main()
     }
 
     std::optional<Shader> vertexShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/vertex_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX });
+        Shader::FromMemory(graphicsDevice, VertexShaderSpv, sizeof(VertexShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX });
 
     if (!vertexShader.has_value())
     {
@@ -52,7 +54,7 @@ int main()
     }
 
     std::optional<Shader> fragmentShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/fragment_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT });
+        Shader::FromMemory(graphicsDevice, FragmentShaderSpv, sizeof(FragmentShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT });
 
     if (!fragmentShader.has_value())
     {
@@ -62,7 +64,7 @@ int main()
     PipelineCreateInfo pipelineInfo = PipelineCreateInfo{
         .VertexShader = &vertexShader.value(),
         .FragmentShader = &fragmentShader.value(),
-        .VertexBufferDescription = {.Slot = 0, .Pitch = 6 * sizeof(float) },
+        .VertexBufferDescriptions = { {.Slot = 0, .Pitch = 6 * sizeof(float) } },
         .VertexAttributes = {
             SDL_GPUVertexAttribute{ .location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 0 },
             SDL_GPUVertexAttribute{ .location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 3 * sizeof(float) }
@@ -143,6 +145,7 @@ int main()
 
     SDL_ReleaseGPUBuffer(graphicsDevice, vertexBuffer);
     pipeline->Release();
+    uploader.Release();
     SDL_ReleaseWindowFromGPUDevice(graphicsDevice, window);
     SDL_DestroyGPUDevice(graphicsDevice);
     SDL_DestroyWindow(window);
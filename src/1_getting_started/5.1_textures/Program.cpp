@@ -1,6 +1,8 @@
 #include <print>
 #include "SDL3/SDL.h"
 #include "Common/misc.h"
+#include "shaders/vertex_shader.spv.h"
+#include "shaders/fragment_shader.spv.h"
 
 float _vertices[] = {
     // vertex              // color             // texture coordinates
@@ -50,7 +52,7 @@ int main()
     }
 
     std::optional<Shader> vertexShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/vertex_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX });
+        Shader::FromMemory(graphicsDevice, VertexShaderSpv, sizeof(VertexShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX });
 
     if (vertexShader == std::nullopt)
     {
@@ -59,7 +61,7 @@ int main()
     }
 
     std::optional<Shader> fragmentShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/fragment_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 1 });
+        Shader::FromMemory(graphicsDevice, FragmentShaderSpv, sizeof(FragmentShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 1 });
 
     if (fragmentShader == std::nullopt)
     {
@@ -70,7 +72,7 @@ int main()
     PipelineCreateInfo pipelineInfo = {
         .VertexShader = &vertexShader.value(),
         .FragmentShader = &fragmentShader.value(),
-        .VertexBufferDescription = {.Slot = 0, .Pitch = 8 * sizeof(float) },
+        .VertexBufferDescriptions = { {.Slot = 0, .Pitch = 8 * sizeof(float) } },
         .VertexAttributes = {
             SDL_GPUVertexAttribute{.location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 0 },
             SDL_GPUVertexAttribute{.location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 3 * sizeof(float)},
@@ -115,7 +117,14 @@ int main()
         return -1;
     }
 
-    Image* image = LoadImage("assets/container.png");
+    ImageLoader imageLoader;
+    std::optional<Image> image = imageLoader.Load("assets/container.png");
+
+    if (image == std::nullopt)
+    {
+        SDL_Log("Failed to load image");
+        return -1;
+    }
 
     SDL_GPUTextureCreateInfo textureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
@@ -141,7 +150,7 @@ int main()
         return -1;
     }
 
-    delete image;
+    image.reset();
 
     SDL_GPUSamplerCreateInfo samplerInfo = {
         .min_filter = SDL_GPU_FILTER_LINEAR,
@@ -207,6 +216,8 @@ int main()
     SDL_ReleaseGPUTexture(graphicsDevice, texture);
     pipeline->Release();
     SDL_ReleaseGPUSampler(graphicsDevice, sampler);
+    gpuUploader.Release();
+    imageLoader.Release();
     SDL_ReleaseWindowFromGPUDevice(graphicsDevice, window);
     SDL_DestroyGPUDevice(graphicsDevice);
     SDL_DestroyWindow(window);
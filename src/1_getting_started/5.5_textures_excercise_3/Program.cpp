@@ -1,6 +1,8 @@
 #include <print>
 #include "SDL3/SDL.h"
 #include "Common/misc.h"
+#include "shaders/vertex_shader.spv.h"
+#include "shaders/fragment_shader.spv.h"
 
 float _vertices[] = {
     // vertex              // color             // texture coordinates
@@ -50,7 +52,7 @@ int main()
     }
 
     std::optional<Shader> vertexShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/vertex_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX });
+        Shader::FromMemory(graphicsDevice, VertexShaderSpv, sizeof(VertexShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX });
 
     if (vertexShader == std::nullopt)
     {
@@ -59,7 +61,7 @@ int main()
     }
 
     std::optional<Shader> fragmentShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/fragment_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 });
+        Shader::FromMemory(graphicsDevice, FragmentShaderSpv, sizeof(FragmentShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 });
 
     if (fragmentShader == std::nullopt)
     {
@@ -70,7 +72,7 @@ int main()
     PipelineCreateInfo pipelineInfo = {
         .VertexShader = &vertexShader.value(),
         .FragmentShader = &fragmentShader.value(),
-        .VertexBufferDescription = {.Slot = 0, .Pitch = 8 * sizeof(float) },
+        .VertexBufferDescriptions = { {.Slot = 0, .Pitch = 8 * sizeof(float) } },
         .VertexAttributes = {
             SDL_GPUVertexAttribute{.location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 0 },
             SDL_GPUVertexAttribute{.location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 3 * sizeof(float)},
@@ -115,7 +117,9 @@ int main()
         return -1;
     }
 
-    Image* containerImage = LoadImage("assets/container.png");
+    ImageLoader imageLoader;
+    std::vector<std::optional<Image>> images = imageLoader.LoadMany({ "assets/container.png", "assets/awesomeface.png" });
+    std::optional<Image>& containerImage = images[0];
 
     SDL_GPUTextureCreateInfo containerTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
@@ -129,7 +133,7 @@ int main()
 
     SDL_GPUTexture* containerTexture = SDL_CreateGPUTexture(graphicsDevice, &containerTextureInfo);
 
-    Image* awesomefaceImage = LoadImage("assets/awesomeface.png");
+    std::optional<Image>& awesomefaceImage = images[1];
 
     SDL_GPUTextureCreateInfo awesomefaceTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
@@ -156,8 +160,8 @@ int main()
         return -1;
     }
 
-    delete containerImage;
-    delete awesomefaceImage;
+    containerImage.reset();
+    awesomefaceImage.reset();
 
     SDL_GPUSamplerCreateInfo samplerInfo = {
         .min_filter = SDL_GPU_FILTER_NEAREST,
@@ -227,6 +231,8 @@ int main()
     SDL_ReleaseGPUTexture(graphicsDevice, awesomefaceTexture);
     pipeline->Release();
     SDL_ReleaseGPUSampler(graphicsDevice, sampler);
+    gpuUploader.Release();
+    imageLoader.Release();
     SDL_ReleaseWindowFromGPUDevice(graphicsDevice, window);
     SDL_DestroyGPUDevice(graphicsDevice);
     SDL_DestroyWindow(window);
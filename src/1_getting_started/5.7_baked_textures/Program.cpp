@@ -0,0 +1,266 @@
+#include <print>
+#include "SDL3/SDL.h"
+#include "Common/misc.h"
+#include "shaders/vertex_shader.spv.h"
+#include "shaders/fragment_shader.spv.h"
+
+float _vertices[] = {
+    // vertex              // color             // texture coordinates
+    -0.9f,  0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    0.0f, 1.0f, // left quad top left
+    -0.9f, -0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    0.0f, 0.0f, // left quad bottom left
+    -0.1f, -0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    1.0f, 0.0f, // left quad bottom right
+    -0.1f,  0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    1.0f, 1.0f, // left quad top right
+
+     0.1f,  0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    0.0f, 1.0f, // right quad top left
+     0.1f, -0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    0.0f, 0.0f, // right quad bottom left
+     0.9f, -0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    1.0f, 0.0f, // right quad bottom right
+     0.9f,  0.4f, 0.0f,    1.0f, 1.0f, 1.0f,    1.0f, 1.0f, // right quad top right
+};
+
+uint32_t _indices[] = {
+    0, 1, 2,
+    0, 2, 3,
+};
+
+const uint64_t FrameUploadBudget = 256 * 1024;
+
+bool _shouldQuit;
+
+void PollEvents();
+
+int main()
+{
+    if (!SDL_Init(SDL_INIT_VIDEO))
+    {
+        SDL_Log("Failed to initialize SDL: %s", SDL_GetError());
+        return -1;
+    }
+
+    SDL_GPUDevice* graphicsDevice = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, true, NULL);
+
+    if (graphicsDevice == NULL)
+    {
+        SDL_Log("Failed to create GPU device: %s", SDL_GetError());
+        return -1;
+    }
+
+    SDL_Window* window = SDL_CreateWindow("LearnSDL3", 800, 600, SDL_WINDOW_RESIZABLE);
+
+    if (window == NULL)
+    {
+        SDL_Log("Failed to create window: %s", SDL_GetError());
+        return -1;
+    }
+
+    if (!SDL_ClaimWindowForGPUDevice(graphicsDevice, window))
+    {
+        SDL_Log("Failed to clain window for GPU device: %s", SDL_GetError());
+        return -1;
+    }
+
+    std::optional<Shader> vertexShader = 
+        Shader::FromMemory(graphicsDevice, VertexShaderSpv, sizeof(VertexShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX });
+
+    if (vertexShader == std::nullopt)
+    {
+        SDL_Log("Failed to create vertex shader: %s", SDL_GetError());
+        return -1;
+    }
+
+    std::optional<Shader> fragmentShader = 
+        Shader::FromMemory(graphicsDevice, FragmentShaderSpv, sizeof(FragmentShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 1 });
+
+    if (fragmentShader == std::nullopt)
+    {
+        SDL_Log("Failed to create fragment shader: %s", SDL_GetError());
+        return -1;
+    }
+
+    PipelineCreateInfo pipelineInfo = {
+        .VertexShader = &vertexShader.value(),
+        .FragmentShader = &fragmentShader.value(),
+        .VertexBufferDescriptions = { {.Slot = 0, .Pitch = 8 * sizeof(float) } },
+        .VertexAttributes = {
+            SDL_GPUVertexAttribute{.location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 0 },
+            SDL_GPUVertexAttribute{.location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 3 * sizeof(float)},
+            SDL_GPUVertexAttribute{.location = 2, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2, .offset = 6 * sizeof(float)},
+        },
+    };
+
+    std::optional<Pipeline> pipeline = Pipeline::Create(graphicsDevice, window, pipelineInfo);
+
+    if (pipeline == std::nullopt)
+    {
+        SDL_Log("Failed to create graphics pipeline: %s", SDL_GetError());
+        return -1;
+    }
+
+    vertexShader->Release();
+    fragmentShader->Release();
+
+    SDL_GPUBufferCreateInfo vertexBufferInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = sizeof(_vertices)
+    };
+
+    SDL_GPUBuffer* vertexBuffer = SDL_CreateGPUBuffer(graphicsDevice, &vertexBufferInfo);
+
+    if (vertexBuffer == NULL)
+    {
+        SDL_Log("Failed to create vertex buffer: %s", SDL_GetError());
+        return -1;
+    }
+
+    SDL_GPUBufferCreateInfo indexBufferInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
+        .size = sizeof(_indices),
+    };
+
+    SDL_GPUBuffer* indexBuffer = SDL_CreateGPUBuffer(graphicsDevice, &indexBufferInfo);
+
+    if (indexBuffer == NULL)
+    {
+        SDL_Log("Failed to create index buffer: %s", SDL_GetError());
+        return -1;
+    }
+
+    SDL_GPUSamplerCreateInfo samplerInfo = {
+        .min_filter = SDL_GPU_FILTER_LINEAR,
+        .mag_filter = SDL_GPU_FILTER_LINEAR,
+        .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_LINEAR,
+        .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+        .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+        .max_lod = 1000.0f,
+    };
+
+    SDL_GPUSampler* sampler = SDL_CreateGPUSampler(graphicsDevice, &samplerInfo);
+
+    GPUUploader gpuUploader(graphicsDevice);
+    UploadQueue uploadQueue(&gpuUploader);
+
+    // Both textures are baked at build time by TextureBaker with their mips, so nothing is
+    // decoded here. The container goes up whole with the buffers below.
+    SDL_GPUTexture* containerTexture = LoadBakedTexture(graphicsDevice, gpuUploader, "baked/container.tex");
+
+    if (containerTexture == NULL)
+    {
+        SDL_Log("Failed to load container texture");
+        return -1;
+    }
+
+    // Only the small mips of the face go up with the buffers, the larger ones stream in over
+    // the first frames.
+    std::optional<StreamingTexture> awesomefaceTexture = StreamingTexture::Open(graphicsDevice, gpuUploader, uploadQueue, "baked/awesomeface.tex", samplerInfo);
+
+    if (awesomefaceTexture == std::nullopt)
+    {
+        SDL_Log("Failed to load awesomeface texture");
+        return -1;
+    }
+
+    gpuUploader.AddVertexData(_vertices, sizeof(_vertices), vertexBuffer, 0);
+    gpuUploader.AddIndexData(_indices, sizeof(_indices), indexBuffer, 0);
+
+    if (!gpuUploader.Upload())
+    {
+        SDL_Log("Could not upload data to GPU: %s", SDL_GetError());
+        return -1;
+    }
+
+    while (!_shouldQuit)
+    {
+        PollEvents();
+
+        uploadQueue.Pump(FrameUploadBudget);
+        awesomefaceTexture->Update();
+
+        SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(graphicsDevice);
+
+        if (commandBuffer == NULL)
+        {
+            SDL_Log("Failed to acquire command buffer: %s", SDL_GetError());
+            return -1;
+        }
+
+        SDL_GPUTexture* swapchainTexture;
+
+        if (!SDL_WaitAndAcquireGPUSwapchainTexture(commandBuffer, window, &swapchainTexture, NULL, NULL))
+        {
+            SDL_Log("Failed to acquire swapchain texture: %s", SDL_GetError());
+            return -1;
+        }
+
+        if (swapchainTexture != NULL)
+        {
+            SDL_GPUColorTargetInfo colorTargetInfo = {
+                .texture = swapchainTexture,
+                .clear_color = { 139.f / 255.f, 139.f / 255.f, 141.f / 255.f, 1.0f },
+                .load_op = SDL_GPU_LOADOP_CLEAR,
+                .store_op = SDL_GPU_STOREOP_STORE,
+            };
+
+            SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(commandBuffer, &colorTargetInfo, 1, NULL);
+
+            SDL_BindGPUGraphicsPipeline(renderPass, pipeline->GetHandle());
+
+            SDL_GPUBufferBinding vertexBufferBinding = { .buffer = vertexBuffer, .offset = 0 };
+            SDL_BindGPUVertexBuffers(renderPass, 0, &vertexBufferBinding, 1);
+
+            SDL_GPUBufferBinding indexBufferBinding = { .buffer = indexBuffer, .offset = 0 };
+            SDL_BindGPUIndexBuffer(renderPass, &indexBufferBinding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
+
+            SDL_GPUTextureSamplerBinding containerSampler = { .texture = containerTexture, .sampler = sampler };
+            SDL_BindGPUFragmentSamplers(renderPass, 0, &containerSampler, 1);
+
+            SDL_DrawGPUIndexedPrimitives(renderPass, 6, 1, 0, 0, 0);
+
+            SDL_GPUTextureSamplerBinding awesomefaceSampler = { .texture = awesomefaceTexture->GetHandle(), .sampler = awesomefaceTexture->GetSampler() };
+            SDL_BindGPUFragmentSamplers(renderPass, 0, &awesomefaceSampler, 1);
+
+            SDL_DrawGPUIndexedPrimitives(renderPass, 6, 1, 0, 4, 0);
+
+            SDL_EndGPURenderPass(renderPass);
+        }
+
+        SDL_SubmitGPUCommandBuffer(commandBuffer);
+    }
+
+    SDL_ReleaseGPUBuffer(graphicsDevice, vertexBuffer);
+    SDL_ReleaseGPUBuffer(graphicsDevice, indexBuffer);
+    SDL_ReleaseGPUTexture(graphicsDevice, containerTexture);
+    awesomefaceTexture->Release();
+    pipeline->Release();
+    SDL_ReleaseGPUSampler(graphicsDevice, sampler);
+    gpuUploader.Release();
+    SDL_ReleaseWindowFromGPUDevice(graphicsDevice, window);
+    SDL_DestroyGPUDevice(graphicsDevice);
+    SDL_DestroyWindow(window);
+    return 0;
+}
+
+void ProcessInput(const SDL_Event& event);
+
+void PollEvents()
+{
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        switch (event.type)
+        {
+        case SDL_EVENT_QUIT:
+            _shouldQuit = true;
+            break;
+        case SDL_EVENT_KEY_DOWN:
+            ProcessInput(event);
+            break;
+        }
+    }
+}
+
+void ProcessInput(const SDL_Event& event)
+{
+    if (event.key.key == SDLK_ESCAPE)
+    {
+        _shouldQuit = true;
+    }
+}
\ No newline at end of file
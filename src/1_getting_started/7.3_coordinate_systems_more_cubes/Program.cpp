@@ -1,10 +1,15 @@
 #include <print>
 #include "SDL3/SDL.h"
 #include "Common/misc.h"
+#include "shaders/textured_vertex.h"
+#include "shaders/textured_fragment.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+constexpr ShaderVariant VertexShaderVariant = SelectShaderVariant(TexturedVertexShaders, ShaderFeature::ModelViewProjection);
+constexpr ShaderVariant FragmentShaderVariant = SelectShaderVariant(TexturedFragmentShaders, ShaderFeature::TextureMix);
+
 float _vertices[] = {
     -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
      0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
@@ -65,6 +70,15 @@ uint32_t _indices[] = {
     0, 2, 3,
 };
 
+struct Cube
+{
+    SDL_GPUBuffer* VertexBuffer;
+    SDL_GPUTexture* ContainerTexture;
+    SDL_GPUTexture* AwesomefaceTexture;
+};
+
+const size_t CubeCount = 10;
+
 bool _shouldQuit;
 
 Time _time;
@@ -102,7 +116,7 @@ int main()
     }
 
     std::optional<Shader> vertexShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/vertex_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX, .NumUniformBuffers = 1 });
+        Shader::FromVariant(graphicsDevice, VertexShaderVariant, { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX, .NumUniformBuffers = 1 });
 
     if (vertexShader == std::nullopt)
     {
@@ -111,7 +125,7 @@ int main()
     }
 
     std::optional<Shader> fragmentShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/fragment_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 });
+        Shader::FromVariant(graphicsDevice, FragmentShaderVariant, { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 });
 
     if (fragmentShader == std::nullopt)
     {
@@ -122,15 +136,16 @@ int main()
     PipelineCreateInfo pipelineInfo = {
         .VertexShader = &vertexShader.value(),
         .FragmentShader = &fragmentShader.value(),
-        .VertexBufferDescription = {.Slot = 0, .Pitch = 5 * sizeof(float) },
+        .VertexBufferDescriptions = { {.Slot = 0, .Pitch = 5 * sizeof(float) } },
         .VertexAttributes = {
             SDL_GPUVertexAttribute{.location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 0 },
             SDL_GPUVertexAttribute{.location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2, .offset = 3 * sizeof(float)},
         },
         .DepthStencilFormat = SDL_GPU_TEXTUREFORMAT_D16_UNORM,
+        .Blend = BlendMode::Opaque,
     };
 
-    std::optional<Pipeline> pipeline = Pipeline::Create(graphicsDevice, window, pipelineInfo);
+    std::optional<DepthPrepassPipeline> pipeline = DepthPrepassPipeline::Create(graphicsDevice, window, pipelineInfo);
 
     if (pipeline == std::nullopt)
     {
@@ -141,51 +156,10 @@ int main()
     vertexShader->Release();
     fragmentShader->Release();
 
-    SDL_GPUBufferCreateInfo vertexBufferInfo = {
-        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-        .size = sizeof(_vertices)
-    };
-
-    SDL_GPUBuffer* vertexBuffer = SDL_CreateGPUBuffer(graphicsDevice, &vertexBufferInfo);
-
-    if (vertexBuffer == NULL)
-    {
-        SDL_Log("Failed to create vertex buffer: %s", SDL_GetError());
-        return -1;
-    }
-
-    SDL_GPUBufferCreateInfo indexBufferInfo = {
-        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
-        .size = sizeof(_indices),
-    };
-
-    Image* containerImage = LoadImage("assets/container.png");
-
-    SDL_GPUTextureCreateInfo containerTextureInfo = {
-        .type = SDL_GPU_TEXTURETYPE_2D,
-        .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
-        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
-        .width = containerImage->Width,
-        .height = containerImage->Height,
-        .layer_count_or_depth = 1,
-        .num_levels = 1,
-    };
-
-    SDL_GPUTexture* containerTexture = SDL_CreateGPUTexture(graphicsDevice, &containerTextureInfo);
-
-    Image* awesomefaceImage = LoadImage("assets/awesomeface.png");
-
-    SDL_GPUTextureCreateInfo awesomefaceTextureInfo = {
-        .type = SDL_GPU_TEXTURETYPE_2D,
-        .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
-        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
-        .width = awesomefaceImage->Width,
-        .height = awesomefaceImage->Height,
-        .layer_count_or_depth = 1,
-        .num_levels = 1,
-    };
-
-    SDL_GPUTexture* awesomefaceTexture = SDL_CreateGPUTexture(graphicsDevice, &awesomefaceTextureInfo);
+    ImageLoader imageLoader;
+    std::vector<std::optional<Image>> images = imageLoader.LoadMany({ "assets/container.png", "assets/awesomeface.png" });
+    std::optional<Image>& containerImage = images[0];
+    std::optional<Image>& awesomefaceImage = images[1];
 
     SDL_GPUTextureCreateInfo depthTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
@@ -200,10 +174,26 @@ int main()
     SDL_GPUTexture* depthTexture = SDL_CreateGPUTexture(graphicsDevice, &depthTextureInfo);
 
     GPUUploader gpuUploader(graphicsDevice);
+    UploadCache uploadCache(graphicsDevice, &gpuUploader);
 
-    gpuUploader.AddVertexData(_vertices, sizeof(_vertices), vertexBuffer, 0);
-    gpuUploader.AddTextureData(containerImage->Data, containerImage->Width, containerImage->Height, containerTexture);
-    gpuUploader.AddTextureData(awesomefaceImage->Data, awesomefaceImage->Width, awesomefaceImage->Height, awesomefaceTexture);
+    // Every cube acquires its own mesh and textures as if it were loaded on its own. The
+    // cache hands all of them the same buffer and textures and uploads each one only once.
+    Cube cubes[CubeCount];
+
+    for (Cube& cube : cubes)
+    {
+        cube = {
+            .VertexBuffer = uploadCache.AcquireBuffer(_vertices, sizeof(_vertices), SDL_GPU_BUFFERUSAGE_VERTEX),
+            .ContainerTexture = uploadCache.AcquireTexture(containerImage->Data, containerImage->Width, containerImage->Height, SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, true),
+            .AwesomefaceTexture = uploadCache.AcquireTexture(awesomefaceImage->Data, awesomefaceImage->Width, awesomefaceImage->Height, SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, true),
+        };
+
+        if (cube.VertexBuffer == NULL || cube.ContainerTexture == NULL || cube.AwesomefaceTexture == NULL)
+        {
+            SDL_Log("Failed to create cube resources: %s", SDL_GetError());
+            return -1;
+        }
+    }
 
     if (!gpuUploader.Upload())
     {
@@ -211,14 +201,16 @@ int main()
         return -1;
     }
 
-    delete containerImage;
-    delete awesomefaceImage;
+    containerImage.reset();
+    awesomefaceImage.reset();
 
     SDL_GPUSamplerCreateInfo samplerInfo = {
         .min_filter = SDL_GPU_FILTER_LINEAR,
         .mag_filter = SDL_GPU_FILTER_LINEAR,
+        .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_LINEAR,
         .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
         .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+        .max_lod = 1000.0f,
     };
 
     SDL_GPUSampler* sampler = SDL_CreateGPUSampler(graphicsDevice, &samplerInfo);
@@ -274,49 +266,55 @@ int main()
                 .store_op = SDL_GPU_STOREOP_DONT_CARE,
             };
 
-            SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(commandBuffer, &colorTargetInfo, 1, &depthTargetInfo);
-
-            SDL_BindGPUGraphicsPipeline(renderPass, pipeline->GetHandle());
-
-            SDL_GPUBufferBinding vertexBufferBinding = { .buffer = vertexBuffer, .offset = 0 };
-            SDL_BindGPUVertexBuffers(renderPass, 0, &vertexBufferBinding, 1);
+            // Fills the depth buffer first so the second pass shades every pixel only once.
+            pipeline->Render(commandBuffer, colorTargetInfo, depthTargetInfo, [&](SDL_GPURenderPass* renderPass)
+            {
+                for (size_t i = 0; i < CubeCount; i++)
+                {
+                    SDL_GPUBufferBinding vertexBufferBinding = { .buffer = cubes[i].VertexBuffer, .offset = 0 };
+                    SDL_BindGPUVertexBuffers(renderPass, 0, &vertexBufferBinding, 1);
 
-            SDL_GPUTextureSamplerBinding textureSamplers[] = {
-                { .texture = containerTexture, .sampler = sampler },
-                { .texture = awesomefaceTexture, .sampler = sampler },
-            };
-            SDL_BindGPUFragmentSamplers(renderPass, 0, textureSamplers, 2);
+                    SDL_GPUTextureSamplerBinding textureSamplers[] = {
+                        { .texture = cubes[i].ContainerTexture, .sampler = sampler },
+                        { .texture = cubes[i].AwesomefaceTexture, .sampler = sampler },
+                    };
 
-            for (size_t i = 0; i < 10; i++)
-            {
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, cubePositions[i]);
-                float angle = i * 20.0f;
-                model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+                    SDL_BindGPUFragmentSamplers(renderPass, 0, textureSamplers, 2);
 
-                glm::mat4 view = glm::mat4(1.0f);
-                view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, cubePositions[i]);
+                    float angle = i * 20.0f;
+                    model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
 
-                glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+                    glm::mat4 view = glm::mat4(1.0f);
+                    view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
 
-                MatrixUniform matrixUniform{ .Model = model, .View = view, .Projection = projection };
+                    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
 
-                SDL_PushGPUVertexUniformData(commandBuffer, 0, value_ptr(matrixUniform), sizeof(matrixUniform));
-                SDL_DrawGPUPrimitives(renderPass, 36, 1, 0, 0);
-            }
+                    MatrixUniform matrixUniform{ .Model = model, .View = view, .Projection = projection };
 
-            SDL_EndGPURenderPass(renderPass);
+                    SDL_PushGPUVertexUniformData(commandBuffer, 0, value_ptr(matrixUniform), sizeof(matrixUniform));
+                    SDL_DrawGPUPrimitives(renderPass, 36, 1, 0, 0);
+                }
+            });
         }
 
         SDL_SubmitGPUCommandBuffer(commandBuffer);
     }
 
-    SDL_ReleaseGPUBuffer(graphicsDevice, vertexBuffer);
-    SDL_ReleaseGPUTexture(graphicsDevice, containerTexture);
-    SDL_ReleaseGPUTexture(graphicsDevice, awesomefaceTexture);
+    for (Cube& cube : cubes)
+    {
+        uploadCache.ReleaseBuffer(cube.VertexBuffer);
+        uploadCache.ReleaseTexture(cube.ContainerTexture);
+        uploadCache.ReleaseTexture(cube.AwesomefaceTexture);
+    }
+
+    uploadCache.Release();
     SDL_ReleaseGPUTexture(graphicsDevice, depthTexture);
     pipeline->Release();
     SDL_ReleaseGPUSampler(graphicsDevice, sampler);
+    gpuUploader.Release();
+    imageLoader.Release();
     SDL_ReleaseWindowFromGPUDevice(graphicsDevice, window);
     SDL_DestroyGPUDevice(graphicsDevice);
     SDL_DestroyWindow(window);
@@ -1,10 +1,20 @@
 #include <print>
 #include "SDL3/SDL.h"
 #include "Common/misc.h"
+#include "shaders/vertex_shader.spv.h"
+#include "shaders/fragment_shader.spv.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+// Debug builds recompile the shaders when their sources change.
+#ifdef SHADERS_SOURCE_DIR
+const bool ShaderHotReload = true;
+#else
+#define SHADERS_SOURCE_DIR "shaders"
+const bool ShaderHotReload = false;
+#endif
+
 float _vertices[] = {
     -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
      0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
@@ -101,8 +111,8 @@ int main()
         return -1;
     }
 
-    std::optional<Shader> vertexShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/vertex_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX, .NumUniformBuffers = 1 });
+    ShaderCreateInfo vertexShaderInfo = { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX, .NumUniformBuffers = 1 };
+    std::optional<Shader> vertexShader = Shader::FromMemory(graphicsDevice, VertexShaderSpv, sizeof(VertexShaderSpv), vertexShaderInfo);
 
     if (vertexShader == std::nullopt)
     {
@@ -110,8 +120,8 @@ int main()
         return -1;
     }
 
-    std::optional<Shader> fragmentShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/fragment_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 });
+    ShaderCreateInfo fragmentShaderInfo = { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 };
+    std::optional<Shader> fragmentShader = Shader::FromMemory(graphicsDevice, FragmentShaderSpv, sizeof(FragmentShaderSpv), fragmentShaderInfo);
 
     if (fragmentShader == std::nullopt)
     {
@@ -122,12 +132,13 @@ int main()
     PipelineCreateInfo pipelineInfo = {
         .VertexShader = &vertexShader.value(),
         .FragmentShader = &fragmentShader.value(),
-        .VertexBufferDescription = {.Slot = 0, .Pitch = 5 * sizeof(float) },
+        .VertexBufferDescriptions = { {.Slot = 0, .Pitch = 5 * sizeof(float) } },
         .VertexAttributes = {
             SDL_GPUVertexAttribute{.location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, .offset = 0 },
             SDL_GPUVertexAttribute{.location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2, .offset = 3 * sizeof(float)},
         },
         .DepthStencilFormat = SDL_GPU_TEXTUREFORMAT_D16_UNORM,
+        .Blend = BlendMode::Opaque,
     };
 
     std::optional<Pipeline> pipeline = Pipeline::Create(graphicsDevice, window, pipelineInfo);
@@ -141,6 +152,17 @@ int main()
     vertexShader->Release();
     fragmentShader->Release();
 
+    ShaderHotReloader shaderReloader(graphicsDevice, window);
+    size_t pipelineIndex = shaderReloader.AddPipeline(pipeline.value(),
+        { .SourcePath = SHADERS_SOURCE_DIR "/vertex_shader.glsl", .OutputPath = "shaders/vertex_shader.spv", .Info = vertexShaderInfo },
+        { .SourcePath = SHADERS_SOURCE_DIR "/fragment_shader.glsl", .OutputPath = "shaders/fragment_shader.spv", .Info = fragmentShaderInfo },
+        pipelineInfo);
+
+    if (ShaderHotReload)
+    {
+        shaderReloader.Start();
+    }
+
     SDL_GPUBufferCreateInfo vertexBufferInfo = {
         .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
         .size = sizeof(_vertices)
@@ -159,30 +181,32 @@ int main()
         .size = sizeof(_indices),
     };
 
-    Image* containerImage = LoadImage("assets/container.png");
+    ImageLoader imageLoader;
+    std::vector<std::optional<Image>> images = imageLoader.LoadMany({ "assets/container.png", "assets/awesomeface.png" });
+    std::optional<Image>& containerImage = images[0];
 
     SDL_GPUTextureCreateInfo containerTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
         .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
-        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET,
         .width = containerImage->Width,
         .height = containerImage->Height,
         .layer_count_or_depth = 1,
-        .num_levels = 1,
+        .num_levels = GetMipLevelCount(containerImage->Width, containerImage->Height),
     };
 
     SDL_GPUTexture* containerTexture = SDL_CreateGPUTexture(graphicsDevice, &containerTextureInfo);
 
-    Image* awesomefaceImage = LoadImage("assets/awesomeface.png");
+    std::optional<Image>& awesomefaceImage = images[1];
 
     SDL_GPUTextureCreateInfo awesomefaceTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
         .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
-        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET,
         .width = awesomefaceImage->Width,
         .height = awesomefaceImage->Height,
         .layer_count_or_depth = 1,
-        .num_levels = 1,
+        .num_levels = GetMipLevelCount(awesomefaceImage->Width, awesomefaceImage->Height),
     };
 
     SDL_GPUTexture* awesomefaceTexture = SDL_CreateGPUTexture(graphicsDevice, &awesomefaceTextureInfo);
@@ -204,6 +228,8 @@ int main()
     gpuUploader.AddVertexData(_vertices, sizeof(_vertices), vertexBuffer, 0);
     gpuUploader.AddTextureData(containerImage->Data, containerImage->Width, containerImage->Height, containerTexture);
     gpuUploader.AddTextureData(awesomefaceImage->Data, awesomefaceImage->Width, awesomefaceImage->Height, awesomefaceTexture);
+    gpuUploader.GenerateMipmaps(containerTexture);
+    gpuUploader.GenerateMipmaps(awesomefaceTexture);
 
     if (!gpuUploader.Upload())
     {
@@ -211,14 +237,16 @@ int main()
         return -1;
     }
 
-    delete containerImage;
-    delete awesomefaceImage;
+    containerImage.reset();
+    awesomefaceImage.reset();
 
     SDL_GPUSamplerCreateInfo samplerInfo = {
         .min_filter = SDL_GPU_FILTER_LINEAR,
         .mag_filter = SDL_GPU_FILTER_LINEAR,
+        .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_LINEAR,
         .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
         .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+        .max_lod = 1000.0f,
     };
 
     SDL_GPUSampler* sampler = SDL_CreateGPUSampler(graphicsDevice, &samplerInfo);
@@ -242,6 +270,8 @@ int main()
 
         PollEvents();
 
+        shaderReloader.SwapPipelines();
+
         SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(graphicsDevice);
 
         if (commandBuffer == NULL)
@@ -276,7 +306,7 @@ int main()
 
             SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(commandBuffer, &colorTargetInfo, 1, &depthTargetInfo);
 
-            SDL_BindGPUGraphicsPipeline(renderPass, pipeline->GetHandle());
+            SDL_BindGPUGraphicsPipeline(renderPass, shaderReloader.GetHandle(pipelineIndex));
 
             SDL_GPUBufferBinding vertexBufferBinding = { .buffer = vertexBuffer, .offset = 0 };
             SDL_BindGPUVertexBuffers(renderPass, 0, &vertexBufferBinding, 1);
@@ -318,8 +348,11 @@ int main()
     SDL_ReleaseGPUTexture(graphicsDevice, containerTexture);
     SDL_ReleaseGPUTexture(graphicsDevice, awesomefaceTexture);
     SDL_ReleaseGPUTexture(graphicsDevice, depthTexture);
+    shaderReloader.Release();
     pipeline->Release();
     SDL_ReleaseGPUSampler(graphicsDevice, sampler);
+    gpuUploader.Release();
+    imageLoader.Release();
     SDL_ReleaseWindowFromGPUDevice(graphicsDevice, window);
     SDL_DestroyGPUDevice(graphicsDevice);
     SDL_DestroyWindow(window);
@@ -1,6 +1,8 @@
 #include <print>
 #include "SDL3/SDL.h"
 #include "Common/misc.h"
+#include "shaders/vertex_shader.spv.h"
+#include "shaders/fragment_shader.spv.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
@@ -10,6 +12,7 @@
 #include <tuple>
 
 uint32_t AtlasSize = 512;
+const uint64_t FrameUploadBudget = 256 * 1024;
 
 //float _vertices[] = {
 //     // vertex          // texture coordinates
@@ -109,9 +112,14 @@ std::queue<char> chars{};
 stbtt_fontinfo fontInfo;
 uint8_t* fontImage;
 GPUUploader* gpuUploader;
+UploadQueue* uploadQueue;
 FontAtlas fontAtlas;
 SDL_GPUTexture* fontTexture;
 
+// Glyphs rasterized before the whole atlas is staged reach the GPU with it, only the later
+// ones need an upload of their own.
+bool _isAtlasStaged;
+
 int main()
 {
     if (!SDL_Init(SDL_INIT_VIDEO))
@@ -143,7 +151,7 @@ int main()
     }
 
     std::optional<Shader> vertexShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/vertex_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX, .NumUniformBuffers = 1 });
+        Shader::FromMemory(graphicsDevice, VertexShaderSpv, sizeof(VertexShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_VERTEX, .NumUniformBuffers = 1 });
 
     if (vertexShader == std::nullopt)
     {
@@ -152,7 +160,7 @@ int main()
     }
 
     std::optional<Shader> fragmentShader = 
-        Shader::FromSPV(graphicsDevice, "shaders/fragment_shader.spv", { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 });
+        Shader::FromMemory(graphicsDevice, FragmentShaderSpv, sizeof(FragmentShaderSpv), { .ShaderStage = SDL_GPU_SHADERSTAGE_FRAGMENT, .NumSamplers = 2 });
 
     if (fragmentShader == std::nullopt)
     {
@@ -163,7 +171,7 @@ int main()
     PipelineCreateInfo pipelineInfo = {
         .VertexShader = &vertexShader.value(),
         .FragmentShader = &fragmentShader.value(),
-        .VertexBufferDescription = {.Slot = 0, .Pitch = 4 * sizeof(float) },
+        .VertexBufferDescriptions = { {.Slot = 0, .Pitch = 4 * sizeof(float) } },
         .VertexAttributes = {
             SDL_GPUVertexAttribute{.location = 0, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2, .offset = 0 },
             SDL_GPUVertexAttribute{.location = 1, .buffer_slot = 0, .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2, .offset = 2 * sizeof(float)},
@@ -182,9 +190,17 @@ int main()
     vertexShader->Release();
     fragmentShader->Release();
 
-    size_t fontDataSize;
-    void* fontData = SDL_LoadFile("assets/Roboto-Regular.ttf", &fontDataSize);
-    if (!stbtt_InitFont(&fontInfo, (unsigned char*) fontData, stbtt_GetFontOffsetForIndex((unsigned char*) fontData, 0)))
+    // stb_truetype reads the font straight from the mapped file, which stays mapped until exit.
+    std::optional<AssetFile> fontFile = AssetFile::Open("assets/Roboto-Regular.ttf");
+
+    if (fontFile == std::nullopt)
+    {
+        SDL_Log("Could not open font");
+        return -1;
+    }
+
+    const unsigned char* fontData = fontFile->GetData().data();
+    if (!stbtt_InitFont(&fontInfo, fontData, stbtt_GetFontOffsetForIndex(fontData, 0)))
     {
         SDL_Log("Could not init font");
         return -1;
@@ -193,11 +209,11 @@ int main()
 
     fontAtlas = CreateFontAtlas(AtlasSize, AtlasSize);
 
-    fontImage = new uint8_t[AtlasSize * AtlasSize * 4];
+    fontImage = new uint8_t[AtlasSize * AtlasSize]();
 
     SDL_GPUTextureCreateInfo fontTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
-        .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+        .format = SDL_GPU_TEXTUREFORMAT_R8_UNORM,
         .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
         .width = (uint32_t) AtlasSize,
         .height = (uint32_t) AtlasSize,
@@ -208,6 +224,7 @@ int main()
     fontTexture = SDL_CreateGPUTexture(graphicsDevice, &fontTextureInfo);
  
     gpuUploader = new GPUUploader(graphicsDevice);
+    uploadQueue = new UploadQueue(gpuUploader);
 
     //std::string text = "!\"#$%&'()*+\n,-./0123456789\n:;<=>?@ABCDEFGHIJKL\nMNOPQRSTUVWXYZ[\\]\n^_`abcdefghi\njklmnopqrstuvwxy\nz{|}~";
     std::string text = R"(
@@ -252,14 +269,59 @@ int main()
 
 )";
 
-    std::vector<float> vertices;
-    std::vector<uint32_t> indecies;
+    const int32_t fontSize = 40;
+
+    // Rasterize every glyph up front so the buffers can be sized before the quads are
+    // written into staging memory.
+    uint32_t glyphCount = 0;
+
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] != '\n' && GetCharacter(text[i], fontSize))
+        {
+            glyphCount++;
+        }
+    }
+
+    SDL_GPUBufferCreateInfo vertexBufferInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = (uint32_t) (glyphCount * 16 * sizeof(float))
+    };
+
+    SDL_GPUBuffer* vertexBuffer = SDL_CreateGPUBuffer(graphicsDevice, &vertexBufferInfo);
+
+    if (vertexBuffer == NULL)
+    {
+        SDL_Log("Failed to create vertex buffer: %s", SDL_GetError());
+        return -1;
+    }
+
+    SDL_GPUBufferCreateInfo indexBufferInfo = {
+        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
+        .size = (uint32_t) (glyphCount * 6 * sizeof(uint32_t))
+    };
+
+    SDL_GPUBuffer* indexBuffer = SDL_CreateGPUBuffer(graphicsDevice, &indexBufferInfo);
+
+    if (indexBuffer == NULL)
+    {
+        SDL_Log("Failed to create index buffer: %s", SDL_GetError());
+        return -1;
+    }
+
+    // Quads are written straight into staging memory.
+    float* vertices = (float*) gpuUploader->ReserveBufferData(vertexBufferInfo.size, vertexBuffer, 0);
+    uint32_t* indecies = (uint32_t*) gpuUploader->ReserveBufferData(indexBufferInfo.size, indexBuffer, 0);
+
+    if (vertices == NULL || indecies == NULL)
+    {
+        SDL_Log("Failed to reserve staging memory for text");
+        return -1;
+    }
 
     float y = 50.0f;
     float x = -50.0f;
 
-    const int32_t fontSize = 40;
-
     int32_t ascent, descent, lineGap;
     stbtt_GetFontVMetrics(&fontInfo, &ascent, &descent, &lineGap);
     float scale = stbtt_ScaleForPixelHeight(&fontInfo, fontSize);
@@ -308,53 +370,31 @@ int main()
 
             x += character->Advance + kerning;
 
-            vertices.push_back(mincx); vertices.push_back(maxcy); vertices.push_back(minu); vertices.push_back(minv);
-            vertices.push_back(mincx); vertices.push_back(mincy); vertices.push_back(minu); vertices.push_back(maxv);
-            vertices.push_back(maxcx); vertices.push_back(mincy); vertices.push_back(maxu); vertices.push_back(maxv);
-            vertices.push_back(maxcx); vertices.push_back(maxcy); vertices.push_back(maxu); vertices.push_back(minv);
-
-            indecies.push_back(_indices[0] + charIndex * 4);
-            indecies.push_back(_indices[1] + charIndex * 4);
-            indecies.push_back(_indices[2] + charIndex * 4);
-            indecies.push_back(_indices[3] + charIndex * 4);
-            indecies.push_back(_indices[4] + charIndex * 4);
-            indecies.push_back(_indices[5] + charIndex * 4);
+            float* quad = vertices + charIndex * 16;
+            quad[0] = mincx;  quad[1] = maxcy;  quad[2] = minu;  quad[3] = minv;
+            quad[4] = mincx;  quad[5] = mincy;  quad[6] = minu;  quad[7] = maxv;
+            quad[8] = maxcx;  quad[9] = mincy;  quad[10] = maxu; quad[11] = maxv;
+            quad[12] = maxcx; quad[13] = maxcy; quad[14] = maxu; quad[15] = minv;
+
+            uint32_t* quadIndecies = indecies + charIndex * 6;
+            quadIndecies[0] = _indices[0] + charIndex * 4;
+            quadIndecies[1] = _indices[1] + charIndex * 4;
+            quadIndecies[2] = _indices[2] + charIndex * 4;
+            quadIndecies[3] = _indices[3] + charIndex * 4;
+            quadIndecies[4] = _indices[4] + charIndex * 4;
+            quadIndecies[5] = _indices[5] + charIndex * 4;
             charIndex++;
         }
     }
 
+    uint32_t indexCount = charIndex * 6;
+
     y = 50.0f;
     x = -1050.0f;
 
-
-
-    SDL_GPUBufferCreateInfo vertexBufferInfo = {
-        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-        .size = (uint32_t) (vertices.size() * sizeof(float))
-    };
-
-    SDL_GPUBuffer* vertexBuffer = SDL_CreateGPUBuffer(graphicsDevice, &vertexBufferInfo);
-
-    if (vertexBuffer == NULL)
-    {
-        SDL_Log("Failed to create vertex buffer: %s", SDL_GetError());
-        return -1;
-    }
-
-    SDL_GPUBufferCreateInfo indexBufferInfo = {
-        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
-        .size = (uint32_t) (indecies.size() * sizeof(uint32_t))
-    };
-
-    SDL_GPUBuffer* indexBuffer = SDL_CreateGPUBuffer(graphicsDevice, &indexBufferInfo);
-
-    if (indexBuffer == NULL)
-    {
-        SDL_Log("Failed to create index buffer: %s", SDL_GetError());
-        return -1;
-    }
-
-    Image* containerImage = LoadImage("assets/container.png");
+    ImageLoader imageLoader;
+    std::vector<std::optional<Image>> images = imageLoader.LoadMany({ "assets/container.png", "assets/awesomeface.png" });
+    std::optional<Image>& containerImage = images[0];
 
     SDL_GPUTextureCreateInfo containerTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
@@ -368,7 +408,7 @@ int main()
 
     SDL_GPUTexture* containerTexture = SDL_CreateGPUTexture(graphicsDevice, &containerTextureInfo);
 
-    Image* awesomefaceImage = LoadImage("assets/awesomeface.png");
+    std::optional<Image>& awesomefaceImage = images[1];
 
     SDL_GPUTextureCreateInfo awesomefaceTextureInfo = {
         .type = SDL_GPU_TEXTURETYPE_2D,
@@ -402,11 +442,10 @@ int main()
         chars.push(toEnqueue[i]);
     }
 
-    gpuUploader->AddVertexData(vertices.data(), vertices.size() * sizeof(float), vertexBuffer, 0);
-    gpuUploader->AddIndexData(indecies.data(), indecies.size() * sizeof(uint32_t), indexBuffer, 0);
     gpuUploader->AddTextureData(containerImage->Data, containerImage->Width, containerImage->Height, containerTexture);
     gpuUploader->AddTextureData(awesomefaceImage->Data, awesomefaceImage->Width, awesomefaceImage->Height, awesomefaceTexture);
-    gpuUploader->AddTextureData(fontImage, AtlasSize, AtlasSize, fontTexture);
+    gpuUploader->AddTextureData(fontImage, AtlasSize, AtlasSize, fontTexture, SDL_GPU_TEXTUREFORMAT_R8_UNORM);
+    _isAtlasStaged = true;
 
     if (!gpuUploader->Upload())
     {
@@ -414,8 +453,8 @@ int main()
         return -1;
     }
 
-    delete containerImage;
-    delete awesomefaceImage;
+    containerImage.reset();
+    awesomefaceImage.reset();
 
     SDL_GPUSamplerCreateInfo samplerInfo = {
         .min_filter = SDL_GPU_FILTER_LINEAR,
@@ -432,6 +471,8 @@ int main()
 
         PollEvents(window);
 
+        uploadQueue->Pump(FrameUploadBudget);
+
         SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(graphicsDevice);
 
         if (commandBuffer == NULL)
@@ -495,7 +536,7 @@ int main()
             MatrixUniform matrixUniform{ .Model = model, .View = view, .Projection = projection };
 
             SDL_PushGPUVertexUniformData(commandBuffer, 0, value_ptr(matrixUniform), sizeof(matrixUniform));
-            SDL_DrawGPUIndexedPrimitives(renderPass, indecies.size(), 1, 0, 0, 0);
+            SDL_DrawGPUIndexedPrimitives(renderPass, indexCount, 1, 0, 0, 0);
 
             SDL_EndGPURenderPass(renderPass);
         }
@@ -503,9 +544,12 @@ int main()
         SDL_SubmitGPUCommandBuffer(commandBuffer);
     }
 
-    delete fontImage;
-    SDL_free(fontData);
+    delete[] fontImage;
+    fontFile->Release();
+    delete uploadQueue;
+    gpuUploader->Release();
     delete gpuUploader;
+    imageLoader.Release();
 
     SDL_ReleaseGPUBuffer(graphicsDevice, vertexBuffer);
     SDL_ReleaseGPUBuffer(graphicsDevice, indexBuffer);
@@ -663,37 +707,18 @@ Glyph get_glyph(stbtt_fontinfo* fontInfo, char character, int32_t fontSize)
     int glyphIndex = stbtt_FindGlyphIndex(fontInfo, character);
     unsigned char* bitmap = stbtt_GetGlyphBitmap(fontInfo, 0, stbtt_ScaleForPixelHeight(fontInfo, fontSize), glyphIndex, &fontWidth, &fontHeight, &fontOffsetX, &fontOffsetY);
 
-    int32_t size = fontWidth * fontHeight * 4;
-    uint8_t* fontRgba = new uint8_t[fontWidth * fontHeight * 4];
-
-    for (size_t i = 0; i < fontWidth * fontHeight; i++)
-    {
-        fontRgba[i * 4 + 0] = 255;
-        fontRgba[i * 4 + 1] = 255;
-        fontRgba[i * 4 + 2] = 255;
-        fontRgba[i * 4 + 3] = bitmap[i];
-    }
-    void* userdata = nullptr;
-    stbtt_FreeBitmap(bitmap, userdata);
-
-    return Glyph{ .Index = glyphIndex, .Pixels = fontRgba, .Width = (uint32_t) fontWidth, .Height = (uint32_t) fontHeight, .OffsetX = fontOffsetX, .OffsetY = fontOffsetY, };
+    return Glyph{ .Index = glyphIndex, .Pixels = bitmap, .Width = (uint32_t) fontWidth, .Height = (uint32_t) fontHeight, .OffsetX = fontOffsetX, .OffsetY = fontOffsetY, };
 }
 
 void CopyPixels(uint8_t* fontImage, Glyph& font, FontAtlasNode& packedFont)
 {
     const uint32_t Width = AtlasSize;
 
-    size_t yOffset = packedFont.Y * 4;
-    size_t xOffset = packedFont.X * 4;
-    size_t length = font.Width * 4;
-
     for (size_t y = 0; y < font.Height; y++)
     {
-        size_t yCoordinate = y * 4;
-
-        size_t sourceIndex = font.Width * (yCoordinate);
-        size_t destinationIndex = Width * (yCoordinate + yOffset) + xOffset;
-        SDL_memcpy(fontImage + destinationIndex, (uint8_t*) font.Pixels + sourceIndex, length);
+        size_t sourceIndex = font.Width * y;
+        size_t destinationIndex = Width * (y + packedFont.Y) + packedFont.X;
+        SDL_memcpy(fontImage + destinationIndex, (uint8_t*) font.Pixels + sourceIndex, font.Width);
     }
 }
 
@@ -709,10 +734,13 @@ Character* GetCharacter(char character, int32_t fontSize)
         if (packedGlyph.has_value())
         {
             CopyPixels(fontImage, glyph, packedGlyph.value());
-            delete glyph.Pixels;
 
-            gpuUploader->AddTextureData(fontImage, AtlasSize, AtlasSize, fontTexture);
-            gpuUploader->Upload();
+            // New glyphs are batched and go out with the next frame's pump ahead of anything else.
+            if (_isAtlasStaged)
+            {
+                uint8_t* glyphPixels = fontImage + packedGlyph->Y * AtlasSize + packedGlyph->X;
+                uploadQueue->EnqueueTextureRegion(glyphPixels, AtlasSize, packedGlyph->X, packedGlyph->Y, glyph.Width, glyph.Height, fontTexture, SDL_GPU_TEXTUREFORMAT_R8_UNORM, UploadPriority::Critical);
+            }
 
             int32_t advance;
             int32_t bearingX;
@@ -734,6 +762,8 @@ Character* GetCharacter(char character, int32_t fontSize)
 
             _characters.insert(std::pair<std::tuple<char, int32_t>, Character>(key, c));
         }
+
+        stbtt_FreeBitmap((unsigned char*) glyph.Pixels, nullptr);
     }
 
     return &_characters[key];
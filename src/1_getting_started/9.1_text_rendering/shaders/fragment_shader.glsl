@@ -4,10 +4,10 @@ layout (location = 0) in vec2 TexCoord;
 layout (location = 0) out vec4 FragColor;
 
 layout (set = 2, binding = 0) uniform sampler2D containerTexture;
-layout (set = 2, binding = 1) uniform sampler2D awesomefaceTexture;
+layout (set = 2, binding = 1) uniform sampler2D fontAtlasTexture;
 
 void main()
 {
-    //FragColor = mix(texture(containerTexture, TexCoord), texture(awesomefaceTexture, TexCoord), 0.0f);
-    FragColor = texture(awesomefaceTexture, TexCoord);
+    //FragColor = mix(texture(containerTexture, TexCoord), texture(fontAtlasTexture, TexCoord), 0.0f);
+    FragColor = vec4(1.0f, 1.0f, 1.0f, texture(fontAtlasTexture, TexCoord).r);
 }
@@ -3,20 +3,197 @@
 #include "SDL3/SDL.h"
 #include "stb_image.h"
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+// windows.h maps LoadImage to LoadImageA or LoadImageW.
+#undef LoadImage
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+// Pixel conversions pick AVX2 or SSE4.1 at runtime on x86, so only those functions are
+// compiled for the newer instruction sets.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COMMON_X86
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+#elif defined(__ARM_NEON)
+#define COMMON_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef _WIN32
+AssetFile::AssetFile(const uint8_t* data, size_t size, void* fileHandle, void* mappingHandle)
+    : Data(data), Size(size), FileHandle(fileHandle), MappingHandle(mappingHandle)
+{ }
+
+std::optional<AssetFile> AssetFile::Open(const std::string& filePath)
+{
+    HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        SDL_Log("Failed to open %s", filePath.c_str());
+        return std::nullopt;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(fileHandle, &fileSize))
+    {
+        SDL_Log("Failed to get the size of %s", filePath.c_str());
+        CloseHandle(fileHandle);
+        return std::nullopt;
+    }
+
+    // Empty files can not be mapped.
+    if (fileSize.QuadPart == 0)
+    {
+        return AssetFile(nullptr, 0, fileHandle, NULL);
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mappingHandle == NULL)
+    {
+        SDL_Log("Failed to map %s", filePath.c_str());
+        CloseHandle(fileHandle);
+        return std::nullopt;
+    }
+
+    void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+    if (data == NULL)
+    {
+        SDL_Log("Failed to map %s", filePath.c_str());
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return std::nullopt;
+    }
+
+    return AssetFile((const uint8_t*) data, (size_t) fileSize.QuadPart, fileHandle, mappingHandle);
+}
+
+void AssetFile::Release()
+{
+    if (Data != nullptr)
+    {
+        UnmapViewOfFile(Data);
+    }
+
+    if (MappingHandle != NULL)
+    {
+        CloseHandle(MappingHandle);
+    }
+
+    CloseHandle(FileHandle);
+
+    Data = nullptr;
+    Size = 0;
+}
+#else
+AssetFile::AssetFile(const uint8_t* data, size_t size)
+    : Data(data), Size(size)
+{ }
+
+std::optional<AssetFile> AssetFile::Open(const std::string& filePath)
+{
+    int fileDescriptor = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fileDescriptor < 0)
+    {
+        SDL_Log("Failed to open %s", filePath.c_str());
+        return std::nullopt;
+    }
+
+    struct stat fileStatus;
+
+    if (fstat(fileDescriptor, &fileStatus) != 0)
+    {
+        SDL_Log("Failed to get the size of %s", filePath.c_str());
+        close(fileDescriptor);
+        return std::nullopt;
+    }
+
+    // Empty files can not be mapped.
+    if (fileStatus.st_size == 0)
+    {
+        close(fileDescriptor);
+        return AssetFile(nullptr, 0);
+    }
+
+    void* data = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+    // The mapping keeps the file alive on its own.
+    close(fileDescriptor);
+
+    if (data == MAP_FAILED)
+    {
+        SDL_Log("Failed to map %s", filePath.c_str());
+        return std::nullopt;
+    }
+
+    return AssetFile((const uint8_t*) data, (size_t) fileStatus.st_size);
+}
+
+void AssetFile::Release()
+{
+    if (Data != nullptr)
+    {
+        munmap((void*) Data, Size);
+    }
+
+    Data = nullptr;
+    Size = 0;
+}
+#endif
+
+std::span<const uint8_t> AssetFile::GetData() const
+{
+    return { Data, Size };
+}
+
 std::optional<Shader> Shader::FromSPV(SDL_GPUDevice* graphicsDevice, const std::string& shaderPath, const ShaderCreateInfo& shaderCreateInfo)
 {
-    size_t shaderCodeSize;
-    void* shaderCode = SDL_LoadFile(shaderPath.c_str(), &shaderCodeSize);
+    std::optional<AssetFile> shaderFile = AssetFile::Open(shaderPath);
 
-    if (shaderCode == NULL)
+    if (shaderFile == std::nullopt)
     {
         SDL_Log("Failed to load shader");
         return std::nullopt;
     }
 
+    std::span<const uint8_t> shaderCode = shaderFile->GetData();
+    std::optional<Shader> shader = FromMemory(graphicsDevice, shaderCode.data(), shaderCode.size(), shaderCreateInfo);
+
+    shaderFile->Release();
+
+    return shader;
+}
+
+std::optional<Shader> Shader::FromMemory(SDL_GPUDevice* graphicsDevice, const void* code, size_t codeSize, const ShaderCreateInfo& shaderCreateInfo)
+{
     SDL_GPUShaderCreateInfo shaderInfo = {
-        .code_size = shaderCodeSize,
-        .code = (uint8_t*)shaderCode,
+        .code_size = codeSize,
+        .code = (const uint8_t*)code,
         .entrypoint = "main",
         .format = SDL_GPU_SHADERFORMAT_SPIRV,
         .stage = shaderCreateInfo.ShaderStage,
@@ -26,23 +203,26 @@ std::optional<Shader> Shader::FromSPV(SDL_GPUDevice* graphicsDevice, const std::
         .num_uniform_buffers = shaderCreateInfo.NumUniformBuffers,
     };
 
-    SDL_GPUShader* vertexShader = SDL_CreateGPUShader(graphicsDevice, &shaderInfo);
+    SDL_GPUShader* shaderHandle = SDL_CreateGPUShader(graphicsDevice, &shaderInfo);
 
-    if (vertexShader == NULL)
+    if (shaderHandle == NULL)
     {
         SDL_Log("Failed to create shader: %s", SDL_GetError());
         return std::nullopt;
     }
 
-    SDL_free(shaderCode);
-
-    Shader shader(graphicsDevice, vertexShader);
+    Shader shader(graphicsDevice, shaderHandle, HashBytes(code, codeSize), codeSize, shaderCreateInfo);
 
     return shader;
 }
 
-Shader::Shader(SDL_GPUDevice* graphicsDeviceHandle, SDL_GPUShader* shaderHandle)
-    : GraphicsDeviceHandle(graphicsDeviceHandle), ShaderHandle(shaderHandle)
+std::optional<Shader> Shader::FromVariant(SDL_GPUDevice* graphicsDevice, const ShaderVariant& variant, const ShaderCreateInfo& shaderCreateInfo)
+{
+    return FromMemory(graphicsDevice, variant.Code, variant.CodeSize, shaderCreateInfo);
+}
+
+Shader::Shader(SDL_GPUDevice* graphicsDeviceHandle, SDL_GPUShader* shaderHandle, uint64_t codeHash, size_t codeSize, const ShaderCreateInfo& createInfo)
+    : GraphicsDeviceHandle(graphicsDeviceHandle), ShaderHandle(shaderHandle), CodeHash(codeHash), CodeSize(codeSize), CreateInfo(createInfo)
 { }
 
 SDL_GPUShader* Shader::GetHandle() const
@@ -50,11 +230,136 @@ SDL_GPUShader* Shader::GetHandle() const
     return ShaderHandle;
 }
 
+uint64_t Shader::GetCodeHash() const
+{
+    return CodeHash;
+}
+
+size_t Shader::GetCodeSize() const
+{
+    return CodeSize;
+}
+
+const ShaderCreateInfo& Shader::GetCreateInfo() const
+{
+    return CreateInfo;
+}
+
 void Shader::Release()
 {
     SDL_ReleaseGPUShader(GraphicsDeviceHandle, ShaderHandle);
 }
 
+ShaderCache::ShaderCache(SDL_GPUDevice* graphicsDevice)
+    : _graphicsDevice(graphicsDevice)
+{
+
+}
+
+ShaderCache::CacheKey ShaderCache::MakeKey(const std::string& shaderPath, uint64_t codeHash, size_t codeSize, const ShaderCreateInfo& shaderCreateInfo)
+{
+    return {
+        shaderPath,
+        codeHash,
+        codeSize,
+        shaderCreateInfo.ShaderStage,
+        shaderCreateInfo.NumSamplers,
+        shaderCreateInfo.NumStorageTextures,
+        shaderCreateInfo.NumStorageBuffers,
+        shaderCreateInfo.NumUniformBuffers,
+    };
+}
+
+Shader* ShaderCache::Acquire(const std::string& shaderPath, const ShaderCreateInfo& shaderCreateInfo)
+{
+    CacheKey key = MakeKey(shaderPath, 0, 0, shaderCreateInfo);
+
+    if (Shader* shader = Find(key, nullptr, 0))
+    {
+        return shader;
+    }
+
+    return Insert(key, Shader::FromSPV(_graphicsDevice, shaderPath, shaderCreateInfo), nullptr, 0);
+}
+
+Shader* ShaderCache::Acquire(const void* code, size_t codeSize, const ShaderCreateInfo& shaderCreateInfo)
+{
+    CacheKey key = MakeKey("", HashBytes(code, codeSize), codeSize, shaderCreateInfo);
+
+    if (Shader* shader = Find(key, code, codeSize))
+    {
+        return shader;
+    }
+
+    return Insert(key, Shader::FromMemory(_graphicsDevice, code, codeSize, shaderCreateInfo), code, codeSize);
+}
+
+Shader* ShaderCache::Find(const CacheKey& key, const void* code, size_t codeSize)
+{
+    auto [first, last] = _entries.equal_range(key);
+
+    for (auto entry = first; entry != last; entry++)
+    {
+        // The hash only narrows the search down, the code decides.
+        if (codeSize == 0 || SDL_memcmp(entry->second.Code.data(), code, codeSize) == 0)
+        {
+            entry->second.ReferenceCount++;
+            return &entry->second.CachedShader;
+        }
+    }
+
+    return nullptr;
+}
+
+Shader* ShaderCache::Insert(const CacheKey& key, std::optional<Shader> shader, const void* code, size_t codeSize)
+{
+    if (!shader.has_value())
+    {
+        return nullptr;
+    }
+
+    const uint8_t* bytes = (const uint8_t*) code;
+
+    auto entry = _entries.emplace(key, CacheEntry{ .CachedShader = shader.value(), .ReferenceCount = 1, .Code = std::vector<uint8_t>(bytes, bytes + codeSize) });
+    _keys[&entry->second.CachedShader] = entry;
+
+    return &entry->second.CachedShader;
+}
+
+void ShaderCache::Release(Shader* shader)
+{
+    auto key = _keys.find(shader);
+
+    if (key == _keys.end())
+    {
+        SDL_Log("Released a shader that is not owned by the shader cache");
+        return;
+    }
+
+    auto entry = key->second;
+
+    if (--entry->second.ReferenceCount > 0)
+    {
+        return;
+    }
+
+    entry->second.CachedShader.Release();
+
+    _entries.erase(entry);
+    _keys.erase(key);
+}
+
+void ShaderCache::Release()
+{
+    for (auto& [key, entry] : _entries)
+    {
+        entry.CachedShader.Release();
+    }
+
+    _entries.clear();
+    _keys.clear();
+}
+
 Pipeline::Pipeline(SDL_GPUDevice* graphicsDevice, SDL_GPUGraphicsPipeline* pipelineHandle)
     : GraphicsDeviceHandle(graphicsDevice), PipelineHandle(pipelineHandle)
 {
@@ -70,59 +375,90 @@ SDL_GPUGraphicsPipeline* Pipeline::GetHandle() const
     return PipelineHandle;
 }
 
+static SDL_GPUColorTargetBlendState GetBlendState(BlendMode blendMode)
+{
+    SDL_GPUColorTargetBlendState blendState = {
+        .color_blend_op = SDL_GPU_BLENDOP_ADD,
+        .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+        .enable_blend = blendMode != BlendMode::Opaque,
+    };
+
+    switch (blendMode)
+    {
+    case BlendMode::Opaque:
+        break;
+    case BlendMode::AlphaBlend:
+        blendState.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
+        blendState.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+        blendState.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
+        blendState.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+        break;
+    case BlendMode::PremultipliedAlpha:
+        blendState.src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+        blendState.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+        blendState.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+        blendState.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+        break;
+    case BlendMode::Additive:
+        blendState.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA;
+        blendState.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+        blendState.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+        blendState.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+        break;
+    }
+
+    return blendState;
+}
+
 std::optional<Pipeline> Pipeline::Create(SDL_GPUDevice* graphicsDevice, SDL_Window* window, const PipelineCreateInfo& createInfo)
 {
-    const VertexBufferDescription& vertexBufferDescription = createInfo.VertexBufferDescription;
+    std::vector<SDL_GPUVertexBufferDescription> vertexBufferDescriptions;
 
-    SDL_GPUVertexBufferDescription vertexBufferDescriptions[] = {
-        {
+    for (const VertexBufferDescription& vertexBufferDescription : createInfo.VertexBufferDescriptions)
+    {
+        vertexBufferDescriptions.push_back({
             .slot = vertexBufferDescription.Slot,
             .pitch = vertexBufferDescription.Pitch,
-            .input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX,
-            .instance_step_rate = 0
-        }
-    };
+            .input_rate = vertexBufferDescription.InputRate,
+            .instance_step_rate = vertexBufferDescription.InstanceStepRate
+        });
+    }
 
     SDL_GPUColorTargetDescription colorTargetDescriptions[1];
     colorTargetDescriptions[0] = {
         .format = SDL_GetGPUSwapchainTextureFormat(graphicsDevice, window),
-        .blend_state = {
-            .src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA,
-            .dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
-            .color_blend_op = SDL_GPU_BLENDOP_ADD,
-
-            .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA,
-            .dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
-            .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
-
-            .enable_blend = true,
-        },
+        .blend_state = GetBlendState(createInfo.Blend),
     };
-        
+
     const std::vector<SDL_GPUVertexAttribute>& vertexAttributes = createInfo.VertexAttributes;
 
     SDL_GPUGraphicsPipelineCreateInfo pipelineInfo = {
         .vertex_shader = createInfo.VertexShader->GetHandle(),
         .fragment_shader = createInfo.FragmentShader->GetHandle(),
         .vertex_input_state = {
-            .vertex_buffer_descriptions = vertexBufferDescriptions,
-            .num_vertex_buffers = 1,
+            .vertex_buffer_descriptions = vertexBufferDescriptions.data(),
+            .num_vertex_buffers = (uint32_t) vertexBufferDescriptions.size(),
             .vertex_attributes = vertexAttributes.data(),
             .num_vertex_attributes = (uint32_t) vertexAttributes.size()
         },
         .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
+        .rasterizer_state = {
+            .fill_mode = SDL_GPU_FILLMODE_FILL,
+            .cull_mode = createInfo.CullMode,
+            .front_face = createInfo.FrontFace,
+        },
         .target_info = {
             .color_target_descriptions = colorTargetDescriptions,
-            .num_color_targets = 1,
+            .num_color_targets = createInfo.DepthOnly ? 0u : 1u,
         },
     };
 
     if (createInfo.DepthStencilFormat.has_value())
     {
         pipelineInfo.depth_stencil_state = {
-            .compare_op = SDL_GPU_COMPAREOP_LESS,
+            .compare_op = createInfo.DepthCompare,
             .enable_depth_test = true,
-            .enable_depth_write = true,
+            .enable_depth_write = createInfo.DepthWrite,
         };
 
         pipelineInfo.target_info.has_depth_stencil_target = true;
@@ -140,173 +476,3504 @@ std::optional<Pipeline> Pipeline::Create(SDL_GPUDevice* graphicsDevice, SDL_Wind
     return Pipeline(graphicsDevice, pipelineHandle);
 }
 
-GPUUploader::GPUUploader(SDL_GPUDevice* graphicsDevice)
-    : _graphicsDevice(graphicsDevice)
+bool PipelineBatch::Compile(SDL_GPUDevice* graphicsDevice, SDL_Window* window, const std::vector<PipelineBatchEntry>& entries, uint32_t threadCount)
 {
+    std::vector<std::pair<size_t, size_t>> shaderIndices;
 
-}
-
-void GPUUploader::AddVertexData(float vertices[], uint32_t size, SDL_GPUBuffer* vertexBuffer, uint32_t bufferOffset)
-{
-    Vertices.push_back(VertexData{ .Vertices = vertices, .Size = size, .VertexBuffer = vertexBuffer, .BufferOffset = bufferOffset });
-}
+    auto findOrAddShader = [this](const std::string& path, const void* code, size_t codeSize, const ShaderCreateInfo& info)
+    {
+        for (size_t i = 0; i < _shaders.size(); i++)
+        {
+            const ShaderCreateInfo& other = _shaders[i].Info;
+
+            if (_shaders[i].Path == path
+                && _shaders[i].Code == code
+                && _shaders[i].CodeSize == codeSize
+                && other.ShaderStage == info.ShaderStage
+                && other.NumSamplers == info.NumSamplers
+                && other.NumStorageTextures == info.NumStorageTextures
+                && other.NumStorageBuffers == info.NumStorageBuffers
+                && other.NumUniformBuffers == info.NumUniformBuffers)
+            {
+                return i;
+            }
+        }
 
-void GPUUploader::AddIndexData(uint32_t indecies[], uint32_t size, SDL_GPUBuffer* indexBuffer, uint32_t bufferOffset)
-{
-    Indecies.push_back(IndexData{ .Indecies = indecies, .Size = size, .IndexBuffer = indexBuffer, .BufferOffset = bufferOffset });
-}
+        _shaders.push_back(ShaderBuild{ .Path = path, .Code = code, .CodeSize = codeSize, .Info = info });
 
-void GPUUploader::AddTextureData(void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture)
-{
-    Textures.push_back(TextureData{ .Pixels = pixels, .Width = width, .Height = height, .Texture = texture });
-}
+        return _shaders.size() - 1;
+    };
 
-bool GPUUploader::Upload()
-{
-    uint32_t totalSize = 0;
+    size_t firstShader = _shaders.size();
+    size_t firstResult = _results.size();
 
-    for (VertexData& vertexData : Vertices)
+    for (const PipelineBatchEntry& entry : entries)
     {
-        totalSize += vertexData.Size;
+        shaderIndices.push_back({
+            findOrAddShader(entry.VertexShaderPath, entry.VertexShaderCode, entry.VertexShaderCodeSize, entry.VertexShaderInfo),
+            findOrAddShader(entry.FragmentShaderPath, entry.FragmentShaderCode, entry.FragmentShaderCodeSize, entry.FragmentShaderInfo),
+        });
     }
 
-    for (IndexData& indexData : Indecies)
+    ParallelFor(_shaders.size() - firstShader, [this, graphicsDevice, firstShader](size_t i)
     {
-        totalSize += indexData.Size;
-    }
+        ShaderBuild& build = _shaders[firstShader + i];
 
-    for (TextureData& textureData : Textures)
-    {
-        totalSize += textureData.Width * textureData.Height * 4;
-    }
+        uint64_t startTicks = SDL_GetTicksNS();
+        build.CompiledShader = build.Code != nullptr
+            ? Shader::FromMemory(graphicsDevice, build.Code, build.CodeSize, build.Info)
+            : Shader::FromSPV(graphicsDevice, build.Path, build.Info);
+        build.CompileNanoseconds = SDL_GetTicksNS() - startTicks;
+    }, threadCount);
 
-    SDL_GPUTransferBufferCreateInfo createInfo = { .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, .size = totalSize };
-    SDL_GPUTransferBuffer* transferBuffer = SDL_CreateGPUTransferBuffer(_graphicsDevice, &createInfo);
+    _results.resize(firstResult + entries.size());
 
-    if (transferBuffer == NULL)
+    ParallelFor(entries.size(), [&](size_t i)
     {
-        SDL_Log("Failed to create transfer buffer: %s", SDL_GetError());
-        return false;
-    }
+        ShaderBuild& vertexShader = _shaders[shaderIndices[i].first];
+        ShaderBuild& fragmentShader = _shaders[shaderIndices[i].second];
+        PipelineBatchResult& result = _results[firstResult + i];
 
-    void* transferData = SDL_MapGPUTransferBuffer(_graphicsDevice, transferBuffer, false);
-    void* currentTransferData = transferData;
+        result.ShaderCompileNanoseconds = vertexShader.CompileNanoseconds + fragmentShader.CompileNanoseconds;
 
-    for (VertexData& vertexData : Vertices)
-    {
-        SDL_memcpy(currentTransferData, vertexData.Vertices, vertexData.Size);
-        currentTransferData = (float*) currentTransferData + vertexData.Size / sizeof(float);
-    }
+        if (!vertexShader.CompiledShader.has_value() || !fragmentShader.CompiledShader.has_value())
+        {
+            return;
+        }
+
+        PipelineCreateInfo pipelineInfo = entries[i].PipelineInfo;
+        pipelineInfo.VertexShader = &vertexShader.CompiledShader.value();
+        pipelineInfo.FragmentShader = &fragmentShader.CompiledShader.value();
 
-    for (IndexData& indexData : Indecies)
+        uint64_t startTicks = SDL_GetTicksNS();
+        result.CompiledPipeline = Pipeline::Create(graphicsDevice, window, pipelineInfo);
+        result.PipelineCompileNanoseconds = SDL_GetTicksNS() - startTicks;
+    }, threadCount);
+
+    for (size_t i = firstResult; i < _results.size(); i++)
     {
-        SDL_memcpy(currentTransferData, indexData.Indecies, indexData.Size);
-        currentTransferData = (uint32_t*) currentTransferData + indexData.Size / sizeof(uint32_t);
+        if (!_results[i].CompiledPipeline.has_value())
+        {
+            return false;
+        }
     }
 
-    for (TextureData& textureData : Textures)
+    return true;
+}
+
+const std::vector<PipelineBatchResult>& PipelineBatch::GetResults() const
+{
+    return _results;
+}
+
+Pipeline* PipelineBatch::GetPipeline(size_t index)
+{
+    if (index >= _results.size() || !_results[index].CompiledPipeline.has_value())
     {
-        SDL_memcpy(currentTransferData, textureData.Pixels, textureData.Width * textureData.Height * 4);
-        currentTransferData = (float*) currentTransferData + textureData.Width * textureData.Height;
+        return nullptr;
     }
 
-    SDL_UnmapGPUTransferBuffer(_graphicsDevice, transferBuffer);
+    return &_results[index].CompiledPipeline.value();
+}
 
-    SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(_graphicsDevice);
-    if (commandBuffer == NULL)
+void PipelineBatch::Release()
+{
+    for (PipelineBatchResult& result : _results)
     {
-        SDL_Log("Failed to acquire a command buffer: %s", SDL_GetError());
-        return false;
+        if (result.CompiledPipeline.has_value())
+        {
+            result.CompiledPipeline->Release();
+        }
     }
 
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
-    uint32_t transferDataOffsetBytes = 0;
-
-    for (VertexData& vertexData : Vertices)
+    for (ShaderBuild& build : _shaders)
     {
-        SDL_GPUTransferBufferLocation transferBufferLocation = {
-            .transfer_buffer = transferBuffer,
-            .offset = transferDataOffsetBytes,
-        };
+        if (build.CompiledShader.has_value())
+        {
+            build.CompiledShader->Release();
+        }
+    }
 
-        SDL_GPUBufferRegion bufferRegion = {
-            .buffer = vertexData.VertexBuffer,
-            .offset = vertexData.BufferOffset,
-            .size = vertexData.Size,
-        };
+    _results.clear();
+    _shaders.clear();
+}
 
-        SDL_UploadToGPUBuffer(copyPass, &transferBufferLocation, &bufferRegion, false);
+DepthPrepassPipeline::DepthPrepassPipeline(const Pipeline& depthPipeline, const Pipeline& colorPipeline)
+    : DepthPipeline(depthPipeline), ColorPipeline(colorPipeline)
+{
 
-        transferDataOffsetBytes += vertexData.Size;
-    }
+}
 
-    for (IndexData& indexData : Indecies)
+std::optional<DepthPrepassPipeline> DepthPrepassPipeline::Create(SDL_GPUDevice* graphicsDevice, SDL_Window* window, const PipelineCreateInfo& createInfo)
+{
+    if (!createInfo.DepthStencilFormat.has_value())
     {
-        SDL_GPUTransferBufferLocation transferBufferLocation = {
-            .transfer_buffer = transferBuffer,
-            .offset = transferDataOffsetBytes,
-        };
+        SDL_Log("Depth prepass needs a depth stencil format");
+        return std::nullopt;
+    }
 
-        SDL_GPUBufferRegion bufferRegion = {
-            .buffer = indexData.IndexBuffer,
-            .offset = indexData.BufferOffset,
-            .size = indexData.Size,
-        };
+    PipelineCreateInfo depthInfo = createInfo;
+    depthInfo.Blend = BlendMode::Opaque;
+    depthInfo.DepthCompare = SDL_GPU_COMPAREOP_LESS;
+    depthInfo.DepthWrite = true;
+    depthInfo.DepthOnly = true;
 
-        SDL_UploadToGPUBuffer(copyPass, &transferBufferLocation, &bufferRegion, false);
+    std::optional<Pipeline> depthPipeline = Pipeline::Create(graphicsDevice, window, depthInfo);
 
-        transferDataOffsetBytes += indexData.Size;
+    if (!depthPipeline.has_value())
+    {
+        return std::nullopt;
     }
 
-    for (TextureData& textureData : Textures)
-    {
-        SDL_GPUTextureTransferInfo transferLocation = {
-            .transfer_buffer = transferBuffer,
-            .offset = transferDataOffsetBytes,
-        };
-        
-        SDL_GPUTextureRegion textureRegion = {
-            .texture = textureData.Texture,
-            .w = textureData.Width,
-            .h = textureData.Height,
-            .d = 1
-        };
+    PipelineCreateInfo colorInfo = createInfo;
+    colorInfo.DepthCompare = SDL_GPU_COMPAREOP_EQUAL;
+    colorInfo.DepthWrite = false;
+    colorInfo.DepthOnly = false;
 
-        SDL_UploadToGPUTexture(copyPass, &transferLocation, &textureRegion, false);
+    std::optional<Pipeline> colorPipeline = Pipeline::Create(graphicsDevice, window, colorInfo);
 
-        transferDataOffsetBytes += textureData.Width * textureData.Height * 4;
+    if (!colorPipeline.has_value())
+    {
+        depthPipeline->Release();
+        return std::nullopt;
     }
 
-    SDL_EndGPUCopyPass(copyPass);
-    SDL_SubmitGPUCommandBuffer(commandBuffer);
-    SDL_ReleaseGPUTransferBuffer(_graphicsDevice, transferBuffer);
+    return DepthPrepassPipeline(depthPipeline.value(), colorPipeline.value());
+}
+
+void DepthPrepassPipeline::Render(SDL_GPUCommandBuffer* commandBuffer, const SDL_GPUColorTargetInfo& colorTargetInfo, const SDL_GPUDepthStencilTargetInfo& depthTargetInfo, const std::function<void(SDL_GPURenderPass*)>& draw) const
+{
+    SDL_GPUDepthStencilTargetInfo prepassDepthTargetInfo = depthTargetInfo;
+    prepassDepthTargetInfo.store_op = SDL_GPU_STOREOP_STORE;
 
-    Vertices.clear();
-    Indecies.clear();
-    Textures.clear();
+    SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(commandBuffer, NULL, 0, &prepassDepthTargetInfo);
+    SDL_BindGPUGraphicsPipeline(renderPass, DepthPipeline.GetHandle());
+    draw(renderPass);
+    SDL_EndGPURenderPass(renderPass);
 
-    return true;
+    SDL_GPUDepthStencilTargetInfo colorDepthTargetInfo = depthTargetInfo;
+    colorDepthTargetInfo.load_op = SDL_GPU_LOADOP_LOAD;
+
+    renderPass = SDL_BeginGPURenderPass(commandBuffer, &colorTargetInfo, 1, &colorDepthTargetInfo);
+    SDL_BindGPUGraphicsPipeline(renderPass, ColorPipeline.GetHandle());
+    draw(renderPass);
+    SDL_EndGPURenderPass(renderPass);
 }
 
-Image::Image(void* data, uint32_t width, uint32_t height, uint32_t channels)
-    : Data(data), Width(width), Height(height), Channels(channels)
+SDL_GPUGraphicsPipeline* DepthPrepassPipeline::GetDepthHandle() const
 {
+    return DepthPipeline.GetHandle();
+}
 
+SDL_GPUGraphicsPipeline* DepthPrepassPipeline::GetColorHandle() const
+{
+    return ColorPipeline.GetHandle();
 }
 
-Image::~Image()
+void DepthPrepassPipeline::Release()
 {
-    stbi_image_free(Data);
+    DepthPipeline.Release();
+    ColorPipeline.Release();
 }
 
-Image* LoadImage(const std::string& filePath)
+PipelineCache::PipelineCache(SDL_GPUDevice* graphicsDevice, SDL_Window* window)
+    : _graphicsDevice(graphicsDevice), _window(window)
 {
-    stbi_set_flip_vertically_on_load(true);
 
+}
+
+size_t PipelineCache::CacheKeyHash::operator()(const CacheKey& key) const
+{
+    return (size_t) HashBytes(key.data(), key.size() * sizeof(uint64_t));
+}
+
+// Shaders are keyed by content, a released shader's handle can be reused by a different one.
+static void AppendShaderKey(std::vector<uint64_t>& key, const Shader& shader)
+{
+    const ShaderCreateInfo& createInfo = shader.GetCreateInfo();
+
+    key.push_back(shader.GetCodeHash());
+    key.push_back(shader.GetCodeSize());
+    key.push_back(createInfo.ShaderStage);
+    key.push_back(createInfo.NumSamplers);
+    key.push_back(createInfo.NumStorageTextures);
+    key.push_back(createInfo.NumStorageBuffers);
+    key.push_back(createInfo.NumUniformBuffers);
+}
+
+PipelineCache::CacheKey PipelineCache::MakeKey(const PipelineCreateInfo& createInfo) const
+{
+    CacheKey key;
+
+    AppendShaderKey(key, *createInfo.VertexShader);
+    AppendShaderKey(key, *createInfo.FragmentShader);
+
+    key.insert(key.end(), {
+        SDL_GetGPUSwapchainTextureFormat(_graphicsDevice, _window),
+        createInfo.DepthStencilFormat.has_value() ? (uint64_t) createInfo.DepthStencilFormat.value() + 1 : 0,
+        (uint64_t) createInfo.Blend,
+        createInfo.CullMode,
+        createInfo.FrontFace,
+        createInfo.DepthCompare,
+        createInfo.DepthWrite,
+        createInfo.DepthOnly,
+        createInfo.VertexBufferDescriptions.size(),
+    });
+
+    for (const VertexBufferDescription& vertexBufferDescription : createInfo.VertexBufferDescriptions)
+    {
+        key.push_back(vertexBufferDescription.Slot);
+        key.push_back(vertexBufferDescription.Pitch);
+        key.push_back(vertexBufferDescription.InputRate);
+        key.push_back(vertexBufferDescription.InstanceStepRate);
+    }
+
+    for (const SDL_GPUVertexAttribute& attribute : createInfo.VertexAttributes)
+    {
+        key.push_back(attribute.location);
+        key.push_back(attribute.buffer_slot);
+        key.push_back(attribute.format);
+        key.push_back(attribute.offset);
+    }
+
+    return key;
+}
+
+Pipeline* PipelineCache::Acquire(const PipelineCreateInfo& createInfo)
+{
+    CacheKey key = MakeKey(createInfo);
+    auto entry = _entries.find(key);
+
+    if (entry != _entries.end())
+    {
+        entry->second.ReferenceCount++;
+        return &entry->second.CachedPipeline;
+    }
+
+    std::optional<Pipeline> pipeline = Pipeline::Create(_graphicsDevice, _window, createInfo);
+
+    if (!pipeline.has_value())
+    {
+        return nullptr;
+    }
+
+    auto [inserted, isNew] = _entries.emplace(key, CacheEntry{ .CachedPipeline = pipeline.value(), .ReferenceCount = 1 });
+    _keys[&inserted->second.CachedPipeline] = key;
+
+    return &inserted->second.CachedPipeline;
+}
+
+void PipelineCache::Release(Pipeline* pipeline)
+{
+    auto key = _keys.find(pipeline);
+
+    if (key == _keys.end())
+    {
+        SDL_Log("Released a pipeline that is not owned by the pipeline cache");
+        return;
+    }
+
+    auto entry = _entries.find(key->second);
+
+    if (--entry->second.ReferenceCount > 0)
+    {
+        return;
+    }
+
+    entry->second.CachedPipeline.Release();
+
+    _entries.erase(entry);
+    _keys.erase(key);
+}
+
+void PipelineCache::Release()
+{
+    for (auto& [key, entry] : _entries)
+    {
+        entry.CachedPipeline.Release();
+    }
+
+    _entries.clear();
+    _keys.clear();
+}
+
+size_t PipelineCache::GetPipelineCount() const
+{
+    return _entries.size();
+}
+
+static const int32_t HotReloadPollMilliseconds = 250;
+
+// Relative output paths point next to the executable, where the build puts the compiled shaders.
+static std::string ResolveOutputPath(const std::string& path)
+{
+    bool isAbsolute = path.starts_with('/') || path.starts_with('\\') || (path.size() > 1 && path[1] == ':');
+    const char* basePath = SDL_GetBasePath();
+
+    if (isAbsolute || basePath == NULL)
+    {
+        return path;
+    }
+
+    return basePath + path;
+}
+
+static std::string GetSourceDirectory(const std::string& path)
+{
+    size_t separator = path.find_last_of('/');
+
+    return separator == std::string::npos ? "." : path.substr(0, separator);
+}
+
+static std::string GetSourceFileName(const std::string& path)
+{
+    size_t separator = path.find_last_of('/');
+
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+}
+
+ShaderHotReloader::ShaderHotReloader(SDL_GPUDevice* graphicsDevice, SDL_Window* window)
+    : _graphicsDevice(graphicsDevice), _window(window)
+{
+
+}
+
+size_t ShaderHotReloader::AddPipeline(const Pipeline& pipeline, const HotShaderSource& vertexShader, const HotShaderSource& fragmentShader, const PipelineCreateInfo& createInfo)
+{
+    _pipelines.push_back(HotPipeline{
+        .Original = pipeline.GetHandle(),
+        .VertexShader = vertexShader,
+        .FragmentShader = fragmentShader,
+        .CreateInfo = createInfo,
+    });
+
+    HotPipeline& hotPipeline = _pipelines.back();
+    hotPipeline.VertexShader.OutputPath = ResolveOutputPath(vertexShader.OutputPath);
+    hotPipeline.FragmentShader.OutputPath = ResolveOutputPath(fragmentShader.OutputPath);
+
+    for (const std::string& sourcePath : { vertexShader.SourcePath, fragmentShader.SourcePath })
+    {
+        std::vector<size_t>& pipelineIndices = _pipelinesBySource[sourcePath];
+
+        if (pipelineIndices.empty() || pipelineIndices.back() != _pipelines.size() - 1)
+        {
+            pipelineIndices.push_back(_pipelines.size() - 1);
+        }
+
+        bool isWatched = false;
+
+        for (auto& [path, modifyTime] : _sources)
+        {
+            isWatched |= path == sourcePath;
+        }
+
+        if (!isWatched)
+        {
+            SDL_PathInfo pathInfo = {};
+            SDL_GetPathInfo(sourcePath.c_str(), &pathInfo);
+
+            _sources.push_back({ sourcePath, pathInfo.modify_time });
+        }
+    }
+
+    return _pipelines.size() - 1;
+}
+
+bool ShaderHotReloader::Start()
+{
+    _mutex = SDL_CreateMutex();
+
+    if (_mutex == NULL)
+    {
+        SDL_Log("Failed to create mutex: %s", SDL_GetError());
+        return false;
+    }
+
+#ifdef __linux__
+    _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (_inotify < 0)
+    {
+        SDL_Log("Failed to initialize inotify, polling shader sources instead");
+    }
+
+    // Sources whose directory can't be watched are polled alongside the inotify events.
+    for (auto& [path, modifyTime] : _sources)
+    {
+        if (_inotify < 0)
+        {
+            break;
+        }
+
+        std::string directory = GetSourceDirectory(path);
+        int watch = inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+        if (watch < 0)
+        {
+            SDL_Log("Failed to watch shader directory %s, polling %s instead", directory.c_str(), path.c_str());
+            _polledSources.push_back(path);
+            continue;
+        }
+
+        _watchedDirectories[watch] = directory;
+    }
+#endif
+
+    _isRunning = true;
+    _thread = SDL_CreateThread(Run, "ShaderHotReloader", this);
+
+    if (_thread == NULL)
+    {
+        SDL_Log("Failed to create shader reload thread: %s", SDL_GetError());
+        _isRunning = false;
+        return false;
+    }
+
+    return true;
+}
+
+int ShaderHotReloader::Run(void* data)
+{
+    ((ShaderHotReloader*) data)->WatchSources();
+
+    return 0;
+}
+
+void ShaderHotReloader::WatchSources()
+{
+    while (_isRunning.load(std::memory_order_acquire))
+    {
+        std::vector<std::string> changedSources = WaitForChanges();
+
+        if (changedSources.empty())
+        {
+            continue;
+        }
+
+        // Each output is compiled once even when several pipelines share it.
+        std::unordered_map<std::string, bool> compiledOutputs;
+        std::map<size_t, bool> affectedPipelines;
+
+        for (const std::string& sourcePath : changedSources)
+        {
+            for (size_t index : _pipelinesBySource[sourcePath])
+            {
+                HotPipeline& pipeline = _pipelines[index];
+                bool isCompiled = true;
+
+                for (const HotShaderSource* shader : { &pipeline.VertexShader, &pipeline.FragmentShader })
+                {
+                    if (shader->SourcePath != sourcePath)
+                    {
+                        continue;
+                    }
+
+                    auto output = compiledOutputs.find(shader->OutputPath);
+
+                    if (output == compiledOutputs.end())
+                    {
+                        output = compiledOutputs.emplace(shader->OutputPath, CompileShader(*shader)).first;
+                    }
+
+                    isCompiled &= output->second;
+                }
+
+                // A pipeline is only rebuilt once all of its changed shaders compile.
+                affectedPipelines.emplace(index, true).first->second &= isCompiled;
+            }
+        }
+
+        std::vector<size_t> pipelineIndices;
+
+        for (auto& [index, isCompiled] : affectedPipelines)
+        {
+            if (isCompiled)
+            {
+                pipelineIndices.push_back(index);
+            }
+        }
+
+        RebuildPipelines(pipelineIndices);
+    }
+}
+
+std::vector<std::string> ShaderHotReloader::WaitForChanges()
+{
+    std::vector<std::string> changedSources;
+
+#ifdef __linux__
+    if (_inotify >= 0)
+    {
+        pollfd pollDescriptor = { .fd = _inotify, .events = POLLIN };
+
+        if (poll(&pollDescriptor, 1, HotReloadPollMilliseconds) > 0)
+        {
+            alignas(inotify_event) char events[4096];
+            ssize_t length;
+
+            while ((length = read(_inotify, events, sizeof(events))) > 0)
+            {
+                for (char* event = events; event < events + length; event += sizeof(inotify_event) + ((inotify_event*) event)->len)
+                {
+                    inotify_event* inotifyEvent = (inotify_event*) event;
+
+                    if (inotifyEvent->len == 0)
+                    {
+                        continue;
+                    }
+
+                    const std::string& directory = _watchedDirectories[inotifyEvent->wd];
+
+                    for (auto& [sourcePath, modifyTime] : _sources)
+                    {
+                        bool isSource = GetSourceDirectory(sourcePath) == directory && GetSourceFileName(sourcePath) == inotifyEvent->name;
+
+                        if (isSource && std::find(changedSources.begin(), changedSources.end(), sourcePath) == changedSources.end())
+                        {
+                            changedSources.push_back(sourcePath);
+                        }
+                    }
+                }
+            }
+        }
+
+        for (auto& source : _sources)
+        {
+            if (std::find(_polledSources.begin(), _polledSources.end(), source.first) != _polledSources.end())
+            {
+                PollSource(source, changedSources);
+            }
+        }
+
+        return changedSources;
+    }
+#endif
+
+    SDL_Delay(HotReloadPollMilliseconds);
+
+    for (auto& source : _sources)
+    {
+        PollSource(source, changedSources);
+    }
+
+    return changedSources;
+}
+
+void ShaderHotReloader::PollSource(std::pair<std::string, SDL_Time>& source, std::vector<std::string>& changedSources)
+{
+    SDL_PathInfo pathInfo;
+
+    if (SDL_GetPathInfo(source.first.c_str(), &pathInfo) && pathInfo.modify_time != source.second)
+    {
+        source.second = pathInfo.modify_time;
+        changedSources.push_back(source.first);
+    }
+}
+
+bool ShaderHotReloader::CompileShader(const HotShaderSource& shader)
+{
+    const char* stage = shader.Info.ShaderStage == SDL_GPU_SHADERSTAGE_VERTEX ? "-fshader-stage=vertex" : "-fshader-stage=fragment";
+    const char* arguments[] = { "glslc", stage, shader.SourcePath.c_str(), "-o", shader.OutputPath.c_str(), NULL };
+
+    // glslc reports errors on stderr, which is folded into the output read below.
+    SDL_PropertiesID properties = SDL_CreateProperties();
+    SDL_SetPointerProperty(properties, SDL_PROP_PROCESS_CREATE_ARGS_POINTER, (void*) arguments);
+    SDL_SetNumberProperty(properties, SDL_PROP_PROCESS_CREATE_STDOUT_NUMBER, SDL_PROCESS_STDIO_APP);
+    SDL_SetBooleanProperty(properties, SDL_PROP_PROCESS_CREATE_STDERR_TO_STDOUT_BOOLEAN, true);
+
+    SDL_Process* process = SDL_CreateProcessWithProperties(properties);
+    SDL_DestroyProperties(properties);
+
+    if (process == NULL)
+    {
+        SDL_Log("Failed to run glslc: %s", SDL_GetError());
+        return false;
+    }
+
+    int exitCode = -1;
+    char* output = (char*) SDL_ReadProcess(process, NULL, &exitCode);
+
+    if (exitCode != 0)
+    {
+        SDL_Log("Failed to compile %s:\n%s", shader.SourcePath.c_str(), output != NULL ? output : "");
+    }
+
+    SDL_free(output);
+    SDL_DestroyProcess(process);
+
+    return exitCode == 0;
+}
+
+void ShaderHotReloader::RebuildPipelines(const std::vector<size_t>& pipelineIndices)
+{
+    for (size_t index : pipelineIndices)
+    {
+        HotPipeline& hotPipeline = _pipelines[index];
+
+        std::optional<Shader> vertexShader = Shader::FromSPV(_graphicsDevice, hotPipeline.VertexShader.OutputPath, hotPipeline.VertexShader.Info);
+        std::optional<Shader> fragmentShader = Shader::FromSPV(_graphicsDevice, hotPipeline.FragmentShader.OutputPath, hotPipeline.FragmentShader.Info);
+        std::optional<Pipeline> pipeline;
+
+        if (vertexShader.has_value() && fragmentShader.has_value())
+        {
+            PipelineCreateInfo createInfo = hotPipeline.CreateInfo;
+            createInfo.VertexShader = &vertexShader.value();
+            createInfo.FragmentShader = &fragmentShader.value();
+
+            pipeline = Pipeline::Create(_graphicsDevice, _window, createInfo);
+        }
+
+        if (vertexShader.has_value())
+        {
+            vertexShader->Release();
+        }
+
+        if (fragmentShader.has_value())
+        {
+            fragmentShader->Release();
+        }
+
+        if (!pipeline.has_value())
+        {
+            continue;
+        }
+
+        SDL_LockMutex(_mutex);
+
+        if (hotPipeline.Rebuilt.has_value())
+        {
+            hotPipeline.Rebuilt->Release();
+        }
+
+        hotPipeline.Rebuilt = pipeline;
+
+        SDL_UnlockMutex(_mutex);
+
+        SDL_Log("Reloaded pipeline using %s and %s", hotPipeline.VertexShader.SourcePath.c_str(), hotPipeline.FragmentShader.SourcePath.c_str());
+    }
+}
+
+void ShaderHotReloader::SwapPipelines()
+{
+    if (_mutex == NULL)
+    {
+        return;
+    }
+
+    SDL_LockMutex(_mutex);
+
+    for (HotPipeline& hotPipeline : _pipelines)
+    {
+        if (!hotPipeline.Rebuilt.has_value())
+        {
+            continue;
+        }
+
+        // The GPU keeps the old pipeline alive until the frames using it have finished.
+        if (hotPipeline.Current.has_value())
+        {
+            hotPipeline.Current->Release();
+        }
+
+        hotPipeline.Current = hotPipeline.Rebuilt;
+        hotPipeline.Rebuilt.reset();
+    }
+
+    SDL_UnlockMutex(_mutex);
+}
+
+SDL_GPUGraphicsPipeline* ShaderHotReloader::GetHandle(size_t index) const
+{
+    const HotPipeline& hotPipeline = _pipelines[index];
+
+    return hotPipeline.Current.has_value() ? hotPipeline.Current->GetHandle() : hotPipeline.Original;
+}
+
+void ShaderHotReloader::Release()
+{
+    if (_thread != NULL)
+    {
+        _isRunning.store(false, std::memory_order_release);
+        SDL_WaitThread(_thread, NULL);
+        _thread = NULL;
+    }
+
+#ifdef __linux__
+    if (_inotify >= 0)
+    {
+        close(_inotify);
+        _inotify = -1;
+    }
+
+    _watchedDirectories.clear();
+    _polledSources.clear();
+#endif
+
+    for (HotPipeline& hotPipeline : _pipelines)
+    {
+        for (std::optional<Pipeline>* pipeline : { &hotPipeline.Current, &hotPipeline.Rebuilt })
+        {
+            if (pipeline->has_value())
+            {
+                (*pipeline)->Release();
+                pipeline->reset();
+            }
+        }
+    }
+
+    if (_mutex != NULL)
+    {
+        SDL_DestroyMutex(_mutex);
+        _mutex = NULL;
+    }
+}
+
+static uint32_t AlignStagingOffset(uint32_t offset)
+{
+    return (offset + StagingAlignment - 1) & ~(StagingAlignment - 1);
+}
+
+TransferRing::TransferRing(SDL_GPUDevice* graphicsDevice, uint32_t capacity)
+    : _graphicsDevice(graphicsDevice), _capacity(capacity)
+{
+
+}
+
+uint32_t TransferRing::GetCapacity() const
+{
+    return _capacity;
+}
+
+std::optional<TransferRing::Allocation> TransferRing::Allocate(uint32_t size)
+{
+    size = AlignStagingOffset(size);
+
+    Reclaim();
+
+    if (_transferBuffer == NULL || size > _capacity)
+    {
+        if (!Grow(size))
+        {
+            return std::nullopt;
+        }
+    }
+
+    while (true)
+    {
+        if (_used == 0)
+        {
+            _head = 0;
+        }
+
+        uint32_t wasted = _head + size > _capacity ? _capacity - _head : 0;
+
+        if (_used + wasted + size <= _capacity)
+        {
+            _used += wasted;
+            _pendingSize += wasted;
+
+            if (wasted > 0)
+            {
+                _head = 0;
+            }
+
+            break;
+        }
+
+        // Only allocations that have not been submitted yet are left, so the copies in flight
+        // can't free up any space.
+        if (_inFlightRegions.empty() || !WaitForOldestRegion())
+        {
+            if (!Grow(size))
+            {
+                return std::nullopt;
+            }
+        }
+    }
+
+    if (_mappedData == NULL)
+    {
+        _mappedData = (uint8_t*) SDL_MapGPUTransferBuffer(_graphicsDevice, _transferBuffer, false);
+
+        if (_mappedData == NULL)
+        {
+            SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
+            return std::nullopt;
+        }
+    }
+
+    Allocation allocation = { .TransferBuffer = _transferBuffer, .Offset = _head, .Data = _mappedData + _head };
+
+    _head += size;
+    _used += size;
+    _pendingSize += size;
+
+    return allocation;
+}
+
+void TransferRing::Unmap()
+{
+    if (_mappedData != NULL)
+    {
+        SDL_UnmapGPUTransferBuffer(_graphicsDevice, _transferBuffer);
+        _mappedData = nullptr;
+    }
+
+    // Orphaned buffers stay mapped until the copies that read from them are recorded.
+    // A failed submission records them again, so each one is only unmapped once.
+    for (size_t i = _unmappedOrphanCount; i < _orphanedBuffers.size(); i++)
+    {
+        SDL_UnmapGPUTransferBuffer(_graphicsDevice, _orphanedBuffers[i]);
+    }
+
+    _unmappedOrphanCount = _orphanedBuffers.size();
+}
+
+UploadTicket TransferRing::Retire(SDL_GPUFence* fence)
+{
+    UploadTicket ticket = { .Id = _nextTicket++ };
+
+    for (SDL_GPUTransferBuffer* transferBuffer : _orphanedBuffers)
+    {
+        SDL_ReleaseGPUTransferBuffer(_graphicsDevice, transferBuffer);
+    }
+
+    _orphanedBuffers.clear();
+    _unmappedOrphanCount = 0;
+
+    _inFlightRegions.push_back(InFlightRegion{ .Fence = fence, .Size = _pendingSize, .Ticket = ticket.Id });
+    _pendingSize = 0;
+
+    return ticket;
+}
+
+void TransferRing::Reclaim()
+{
+    size_t reclaimed = 0;
+
+    for (InFlightRegion& region : _inFlightRegions)
+    {
+        if (region.Fence != NULL && !SDL_QueryGPUFence(_graphicsDevice, region.Fence))
+        {
+            break;
+        }
+
+        if (region.Fence != NULL)
+        {
+            SDL_ReleaseGPUFence(_graphicsDevice, region.Fence);
+        }
+
+        _used -= region.Size;
+        _completedTicket = region.Ticket;
+        reclaimed++;
+    }
+
+    _inFlightRegions.erase(_inFlightRegions.begin(), _inFlightRegions.begin() + reclaimed);
+}
+
+bool TransferRing::IsComplete(UploadTicket ticket)
+{
+    if (ticket.Id > _completedTicket)
+    {
+        Reclaim();
+    }
+
+    return ticket.Id <= _completedTicket;
+}
+
+bool TransferRing::Wait(UploadTicket ticket)
+{
+    while (!IsComplete(ticket))
+    {
+        if (!WaitForOldestRegion())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TransferRing::WaitForOldestRegion()
+{
+    if (_inFlightRegions.empty())
+    {
+        return false;
+    }
+
+    SDL_GPUFence* fence = _inFlightRegions.front().Fence;
+
+    if (fence != NULL && !SDL_WaitForGPUFences(_graphicsDevice, true, &fence, 1))
+    {
+        SDL_Log("Failed to wait for transfer fence: %s", SDL_GetError());
+        return false;
+    }
+
+    Reclaim();
+
+    return true;
+}
+
+bool TransferRing::Grow(uint32_t size)
+{
+    uint32_t capacity = _capacity;
+
+    if (_transferBuffer != NULL)
+    {
+        capacity = std::max(capacity * 2, size);
+    }
+    else
+    {
+        capacity = std::max(capacity, size);
+    }
+
+    SDL_GPUTransferBufferCreateInfo createInfo = { .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, .size = capacity };
+    SDL_GPUTransferBuffer* transferBuffer = SDL_CreateGPUTransferBuffer(_graphicsDevice, &createInfo);
+
+    if (transferBuffer == NULL)
+    {
+        SDL_Log("Failed to create transfer buffer: %s", SDL_GetError());
+        return false;
+    }
+
+    // The old buffer stays alive on the GPU until the copies that reference it finish,
+    // its regions are only kept around to track tickets. If it still holds data that
+    // hasn't been submitted, it is released after the next submission instead.
+    if (_pendingSize > 0)
+    {
+        _orphanedBuffers.push_back(_transferBuffer);
+    }
+    else if (_transferBuffer != NULL)
+    {
+        Unmap();
+        SDL_ReleaseGPUTransferBuffer(_graphicsDevice, _transferBuffer);
+    }
+
+    _mappedData = nullptr;
+
+    for (InFlightRegion& region : _inFlightRegions)
+    {
+        region.Size = 0;
+    }
+
+    _transferBuffer = transferBuffer;
+    _capacity = capacity;
+    _head = 0;
+    _used = 0;
+    _pendingSize = 0;
+
+    return true;
+}
+
+void TransferRing::Release()
+{
+    Unmap();
+
+    for (InFlightRegion& region : _inFlightRegions)
+    {
+        if (region.Fence != NULL)
+        {
+            SDL_ReleaseGPUFence(_graphicsDevice, region.Fence);
+        }
+    }
+
+    _inFlightRegions.clear();
+    _completedTicket = _nextTicket - 1;
+
+    for (SDL_GPUTransferBuffer* transferBuffer : _orphanedBuffers)
+    {
+        SDL_ReleaseGPUTransferBuffer(_graphicsDevice, transferBuffer);
+    }
+
+    _orphanedBuffers.clear();
+    _unmappedOrphanCount = 0;
+
+    if (_transferBuffer != NULL)
+    {
+        SDL_ReleaseGPUTransferBuffer(_graphicsDevice, _transferBuffer);
+        _transferBuffer = nullptr;
+    }
+
+    _head = 0;
+    _used = 0;
+    _pendingSize = 0;
+}
+
+GPUUploader::GPUUploader(SDL_GPUDevice* graphicsDevice, uint32_t stagingSize)
+    : _graphicsDevice(graphicsDevice), _transferRing(graphicsDevice, stagingSize)
+{
+
+}
+
+bool GPUUploader::AddVertexData(float vertices[], uint32_t size, SDL_GPUBuffer* vertexBuffer, uint32_t bufferOffset)
+{
+    return AddBufferData(vertices, size, vertexBuffer, bufferOffset);
+}
+
+bool GPUUploader::AddIndexData(uint32_t indecies[], uint32_t size, SDL_GPUBuffer* indexBuffer, uint32_t bufferOffset)
+{
+    return AddBufferData(indecies, size, indexBuffer, bufferOffset);
+}
+
+bool GPUUploader::AddBufferData(const void* data, uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset)
+{
+    const uint8_t* source = (const uint8_t*) data;
+    uint64_t chunkSize = GetChunkSize();
+
+    while (size > 0)
+    {
+        uint32_t copySize = (uint32_t) std::min<uint64_t>(size, chunkSize);
+
+        FlushIfChunkFull(copySize);
+
+        void* destination = ReserveBufferData(copySize, buffer, bufferOffset);
+
+        if (destination == NULL)
+        {
+            return false;
+        }
+
+        SDL_memcpy(destination, source, copySize);
+
+        source += copySize;
+        bufferOffset += copySize;
+        size -= copySize;
+    }
+
+    return true;
+}
+
+bool GPUUploader::AddTextureData(void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format)
+{
+    return AddTextureRegion(pixels, width, 0, 0, width, height, texture, format);
+}
+
+bool GPUUploader::AddTextureRegion(void* pixels, uint32_t pixelsPerRow, uint32_t x, uint32_t y, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format)
+{
+    TextureUploadRegion region = {
+        .Texture = texture,
+        .Format = format,
+        .X = x,
+        .Y = y,
+        .Width = width,
+        .Height = height,
+    };
+
+    return AddTextureSubresource(pixels, region, pixelsPerRow);
+}
+
+bool GPUUploader::AddTextureSubresource(const void* pixels, const TextureUploadRegion& region, uint32_t pixelsPerRow, uint32_t rowsPerLayer)
+{
+    if (region.Width == 0 || region.Height == 0 || region.Depth == 0)
+    {
+        return true;
+    }
+
+    pixelsPerRow = pixelsPerRow == 0 ? region.Width : pixelsPerRow;
+    rowsPerLayer = rowsPerLayer == 0 ? region.Height : rowsPerLayer;
+
+    // Rows are counted in blocks so compressed formats are split on block boundaries.
+    uint32_t blockExtent = GetTextureFormatBlockExtent(region.Format);
+    uint64_t blockSize = SDL_GPUTextureFormatTexelBlockSize(region.Format);
+
+    uint64_t rowSize = (region.Width + blockExtent - 1) / blockExtent * blockSize;
+    uint64_t sourceRowSize = (pixelsPerRow + blockExtent - 1) / blockExtent * blockSize;
+    uint64_t sourceSliceSize = (rowsPerLayer + blockExtent - 1) / blockExtent * sourceRowSize;
+    uint32_t blockRows = (region.Height + blockExtent - 1) / blockExtent;
+    uint32_t blockRowsPerChunk = (uint32_t) std::max<uint64_t>(GetChunkSize() / rowSize, 1);
+
+    for (uint32_t slice = 0; slice < region.Depth; slice++)
+    {
+        const uint8_t* sourceRow = (const uint8_t*) pixels + slice * sourceSliceSize;
+
+        for (uint32_t blockRow = 0; blockRow < blockRows; blockRow += blockRowsPerChunk)
+        {
+            uint32_t chunkBlockRows = std::min(blockRowsPerChunk, blockRows - blockRow);
+            uint32_t chunkY = blockRow * blockExtent;
+
+            TextureUploadRegion chunkRegion = region;
+            chunkRegion.Y = region.Y + chunkY;
+            chunkRegion.Z = region.Z + slice;
+            chunkRegion.Height = std::min(chunkBlockRows * blockExtent, region.Height - chunkY);
+            chunkRegion.Depth = 1;
+
+            FlushIfChunkFull(chunkBlockRows * rowSize);
+
+            uint8_t* destination = (uint8_t*) ReserveTextureSubresource(chunkRegion);
+
+            if (destination == NULL)
+            {
+                return false;
+            }
+
+            // Rows are packed tightly in staging memory so only the region itself is transferred.
+            if (sourceRowSize == rowSize)
+            {
+                SDL_memcpy(destination, sourceRow, chunkBlockRows * rowSize);
+                sourceRow += chunkBlockRows * rowSize;
+                continue;
+            }
+
+            for (uint32_t row = 0; row < chunkBlockRows; row++)
+            {
+                SDL_memcpy(destination, sourceRow, rowSize);
+                destination += rowSize;
+                sourceRow += sourceRowSize;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool GPUUploader::AddTextureMipChain(const void* pixels, uint32_t width, uint32_t height, uint32_t levelCount, SDL_GPUTexture* texture, SDL_GPUTextureFormat format, uint32_t layer)
+{
+    const uint8_t* levelPixels = (const uint8_t*) pixels;
+
+    for (uint32_t mipLevel = 0; mipLevel < levelCount; mipLevel++)
+    {
+        TextureUploadRegion region = {
+            .Texture = texture,
+            .Format = format,
+            .MipLevel = mipLevel,
+            .Layer = layer,
+            .Width = std::max(width >> mipLevel, 1u),
+            .Height = std::max(height >> mipLevel, 1u),
+        };
+
+        if (!AddTextureSubresource(levelPixels, region))
+        {
+            return false;
+        }
+
+        levelPixels += GetTextureSubresourceSize(format, region.Width, region.Height);
+    }
+
+    return true;
+}
+
+void GPUUploader::GenerateMipmaps(SDL_GPUTexture* texture)
+{
+    MipmapTextures.push_back(texture);
+}
+
+void* GPUUploader::ReserveBufferData(uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+
+    std::optional<TransferRing::Allocation> allocation = _transferRing.Allocate(size);
+
+    if (allocation == std::nullopt)
+    {
+        SDL_Log("Failed to reserve %u bytes of staging memory", size);
+        return nullptr;
+    }
+
+    BufferCopies.push_back(BufferCopy{
+        .TransferBuffer = allocation->TransferBuffer,
+        .TransferOffset = allocation->Offset,
+        .Buffer = buffer,
+        .BufferOffset = bufferOffset,
+        .Size = size,
+    });
+
+    _pendingStagingSize += size;
+
+    return allocation->Data;
+}
+
+void* GPUUploader::ReserveTextureRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format)
+{
+    TextureUploadRegion region = {
+        .Texture = texture,
+        .Format = format,
+        .X = x,
+        .Y = y,
+        .Width = width,
+        .Height = height,
+    };
+
+    return ReserveTextureSubresource(region);
+}
+
+void* GPUUploader::ReserveTextureSubresource(const TextureUploadRegion& region)
+{
+    if (region.Width == 0 || region.Height == 0 || region.Depth == 0)
+    {
+        return nullptr;
+    }
+
+    uint32_t blockExtent = GetTextureFormatBlockExtent(region.Format);
+    uint32_t pixelsPerRow = (region.Width + blockExtent - 1) / blockExtent * blockExtent;
+    uint32_t rowsPerLayer = (region.Height + blockExtent - 1) / blockExtent * blockExtent;
+
+    uint64_t size = GetTextureSubresourceSize(region.Format, region.Width, region.Height, region.Depth);
+
+    if (size > UINT32_MAX)
+    {
+        SDL_Log("Texture region of %llu bytes is too large to reserve at once", (unsigned long long) size);
+        return nullptr;
+    }
+
+    std::optional<TransferRing::Allocation> allocation = _transferRing.Allocate((uint32_t) size);
+
+    if (allocation == std::nullopt)
+    {
+        SDL_Log("Failed to reserve %llu bytes of staging memory", (unsigned long long) size);
+        return nullptr;
+    }
+
+    TextureCopies.push_back(TextureCopy{
+        .TransferBuffer = allocation->TransferBuffer,
+        .TransferOffset = allocation->Offset,
+        .Region = region,
+        .PixelsPerRow = pixelsPerRow,
+        .RowsPerLayer = rowsPerLayer,
+    });
+
+    _pendingStagingSize += size;
+
+    return allocation->Data;
+}
+
+uint64_t GPUUploader::GetChunkSize() const
+{
+    // Half of the ring, so one chunk can be filled while the previous one is being copied.
+    return std::max<uint64_t>(_transferRing.GetCapacity() / 2, StagingAlignment);
+}
+
+void GPUUploader::FlushIfChunkFull(uint64_t size)
+{
+    if (_pendingStagingSize > 0 && _pendingStagingSize + size > GetChunkSize())
+    {
+        if (UploadAsync() == std::nullopt)
+        {
+            SDL_Log("Failed to submit upload chunk");
+        }
+    }
+}
+
+bool GPUUploader::Upload()
+{
+    return UploadAsync().has_value();
+}
+
+std::optional<UploadTicket> GPUUploader::UploadAsync()
+{
+    if (BufferCopies.empty() && TextureCopies.empty() && MipmapTextures.empty())
+    {
+        return _transferRing.Retire(NULL);
+    }
+
+    _transferRing.Unmap();
+
+    // On failure the copies and their staging memory are kept, so the next upload submits them again.
+    SDL_GPUCommandBuffer* commandBuffer = SDL_AcquireGPUCommandBuffer(_graphicsDevice);
+    if (commandBuffer == NULL)
+    {
+        SDL_Log("Failed to acquire a command buffer: %s", SDL_GetError());
+        return std::nullopt;
+    }
+
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(commandBuffer);
+
+    for (BufferCopy& bufferCopy : BufferCopies)
+    {
+        SDL_GPUTransferBufferLocation transferBufferLocation = {
+            .transfer_buffer = bufferCopy.TransferBuffer,
+            .offset = bufferCopy.TransferOffset,
+        };
+
+        SDL_GPUBufferRegion bufferRegion = {
+            .buffer = bufferCopy.Buffer,
+            .offset = bufferCopy.BufferOffset,
+            .size = bufferCopy.Size,
+        };
+
+        SDL_UploadToGPUBuffer(copyPass, &transferBufferLocation, &bufferRegion, false);
+    }
+
+    for (TextureCopy& textureCopy : TextureCopies)
+    {
+        SDL_GPUTextureTransferInfo transferLocation = {
+            .transfer_buffer = textureCopy.TransferBuffer,
+            .offset = textureCopy.TransferOffset,
+            .pixels_per_row = textureCopy.PixelsPerRow,
+            .rows_per_layer = textureCopy.RowsPerLayer,
+        };
+        
+        const TextureUploadRegion& region = textureCopy.Region;
+
+        SDL_GPUTextureRegion textureRegion = {
+            .texture = region.Texture,
+            .mip_level = region.MipLevel,
+            .layer = region.Layer,
+            .x = region.X,
+            .y = region.Y,
+            .z = region.Z,
+            .w = region.Width,
+            .h = region.Height,
+            .d = region.Depth
+        };
+
+        SDL_UploadToGPUTexture(copyPass, &transferLocation, &textureRegion, false);
+    }
+
+    SDL_EndGPUCopyPass(copyPass);
+
+    for (SDL_GPUTexture* texture : MipmapTextures)
+    {
+        SDL_GenerateMipmapsForGPUTexture(commandBuffer, texture);
+    }
+
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(commandBuffer);
+
+    // Without a fence there is no telling when the GPU is done reading the staging memory,
+    // so it must not be retired and handed out again.
+    if (fence == NULL)
+    {
+        SDL_Log("Failed to submit upload command buffer: %s", SDL_GetError());
+        return std::nullopt;
+    }
+
+    UploadTicket ticket = _transferRing.Retire(fence);
+
+    BufferCopies.clear();
+    TextureCopies.clear();
+    MipmapTextures.clear();
+    _pendingStagingSize = 0;
+
+    return ticket;
+}
+
+bool GPUUploader::IsResident(UploadTicket ticket)
+{
+    return _transferRing.IsComplete(ticket);
+}
+
+bool GPUUploader::Wait(UploadTicket ticket)
+{
+    return _transferRing.Wait(ticket);
+}
+
+void GPUUploader::Release()
+{
+    _transferRing.Release();
+}
+
+UploadQueue::UploadQueue(GPUUploader* uploader)
+    : _uploader(uploader)
+{
+
+}
+
+UploadRequestId UploadQueue::EnqueueBufferData(const void* data, uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset, UploadPriority priority)
+{
+    UploadRequest request = {
+        .Data = (const uint8_t*) data,
+        .Buffer = buffer,
+        .BufferOffset = bufferOffset,
+        .Size = size,
+    };
+
+    return Enqueue(request, priority);
+}
+
+UploadRequestId UploadQueue::EnqueueTextureData(const void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format, UploadPriority priority)
+{
+    return EnqueueTextureRegion(pixels, width, 0, 0, width, height, texture, format, priority);
+}
+
+UploadRequestId UploadQueue::EnqueueTextureRegion(const void* pixels, uint32_t pixelsPerRow, uint32_t x, uint32_t y, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format, UploadPriority priority)
+{
+    TextureUploadRegion region = {
+        .Texture = texture,
+        .Format = format,
+        .X = x,
+        .Y = y,
+        .Width = width,
+        .Height = height,
+    };
+
+    return EnqueueTextureSubresource(pixels, region, pixelsPerRow, priority);
+}
+
+UploadRequestId UploadQueue::EnqueueTextureSubresource(const void* pixels, const TextureUploadRegion& region, uint32_t pixelsPerRow, UploadPriority priority)
+{
+    UploadRequest request = {
+        .Data = (const uint8_t*) pixels,
+        .Texture = region,
+        .PixelsPerRow = pixelsPerRow == 0 ? region.Width : pixelsPerRow,
+    };
+
+    return Enqueue(request, priority);
+}
+
+UploadRequestId UploadQueue::Enqueue(const UploadRequest& request, UploadPriority priority)
+{
+    UploadRequestId requestId = { .Id = _nextRequestId++ };
+
+    if (GetRemainingBytes(request) == 0)
+    {
+        return requestId;
+    }
+
+    _requests[(size_t) priority].push_back(request);
+    _requests[(size_t) priority].back().Id = requestId.Id;
+    _queuedRequests.insert(requestId.Id);
+
+    return requestId;
+}
+
+uint64_t UploadQueue::GetRemainingBytes(const UploadRequest& request) const
+{
+    if (!request.Texture.has_value())
+    {
+        return request.Size - request.Progress;
+    }
+
+    const TextureUploadRegion& region = request.Texture.value();
+    uint32_t blockExtent = GetTextureFormatBlockExtent(region.Format);
+    uint64_t rowSize = (region.Width + blockExtent - 1) / blockExtent * (uint64_t) SDL_GPUTextureFormatTexelBlockSize(region.Format);
+    uint64_t blockRows = (uint64_t) (region.Height + blockExtent - 1) / blockExtent * region.Depth;
+
+    return (blockRows - request.Progress) * rowSize;
+}
+
+uint64_t UploadQueue::StageRequest(UploadRequest& request, uint64_t budgetBytes, bool isCritical)
+{
+    if (!request.Texture.has_value())
+    {
+        uint32_t size = request.Size - request.Progress;
+
+        if (!isCritical)
+        {
+            size = (uint32_t) std::min<uint64_t>(size, budgetBytes);
+        }
+
+        if (!_uploader->AddBufferData(request.Data + request.Progress, size, request.Buffer, request.BufferOffset + request.Progress))
+        {
+            return 0;
+        }
+
+        request.Progress += size;
+
+        return size;
+    }
+
+    const TextureUploadRegion& region = request.Texture.value();
+    uint32_t blockExtent = GetTextureFormatBlockExtent(region.Format);
+    uint64_t blockSize = SDL_GPUTextureFormatTexelBlockSize(region.Format);
+    uint64_t rowSize = (region.Width + blockExtent - 1) / blockExtent * blockSize;
+    uint64_t sourceRowSize = (request.PixelsPerRow + blockExtent - 1) / blockExtent * blockSize;
+    uint32_t blockRows = (region.Height + blockExtent - 1) / blockExtent;
+
+    // A single pump never crosses a slice of a 3D region.
+    uint32_t slice = request.Progress / blockRows;
+    uint32_t sliceRow = request.Progress % blockRows;
+    uint32_t rows = blockRows - sliceRow;
+
+    // At least one row goes out so a row larger than the budget can't stall the queue.
+    if (!isCritical)
+    {
+        rows = (uint32_t) std::clamp<uint64_t>(budgetBytes / rowSize, 1, rows);
+    }
+
+    TextureUploadRegion chunkRegion = region;
+    chunkRegion.Y = region.Y + sliceRow * blockExtent;
+    chunkRegion.Z = region.Z + slice;
+    chunkRegion.Height = std::min(rows * blockExtent, region.Height - sliceRow * blockExtent);
+    chunkRegion.Depth = 1;
+
+    const uint8_t* source = request.Data + (slice * (uint64_t) blockRows + sliceRow) * sourceRowSize;
+
+    if (!_uploader->AddTextureSubresource(source, chunkRegion, request.PixelsPerRow))
+    {
+        return 0;
+    }
+
+    request.Progress += rows;
+
+    return rows * rowSize;
+}
+
+std::optional<UploadTicket> UploadQueue::Pump(uint64_t budgetBytes, uint64_t budgetMicroseconds)
+{
+    uint64_t startTicks = SDL_GetTicksNS();
+    uint64_t remainingBytes = budgetBytes;
+    bool isStagingFull = false;
+
+    for (size_t priority = 0; priority < (size_t) UploadPriority::Count && !isStagingFull; priority++)
+    {
+        std::deque<UploadRequest>& requests = _requests[priority];
+        bool isCritical = priority == (size_t) UploadPriority::Critical;
+
+        while (!requests.empty())
+        {
+            if (!isCritical)
+            {
+                bool isOverTime = budgetMicroseconds > 0 && (SDL_GetTicksNS() - startTicks) / 1000 >= budgetMicroseconds;
+
+                if (remainingBytes == 0 || isOverTime)
+                {
+                    break;
+                }
+            }
+
+            UploadRequest& request = requests.front();
+            uint64_t stagedBytes = StageRequest(request, remainingBytes, isCritical);
+
+            // Out of staging memory, the request keeps its progress and is tried again next pump.
+            if (stagedBytes == 0)
+            {
+                isStagingFull = true;
+                break;
+            }
+
+            remainingBytes -= std::min(stagedBytes, remainingBytes);
+
+            if (GetRemainingBytes(request) == 0)
+            {
+                _unsubmittedRequests.push_back(request.Id);
+                requests.pop_front();
+            }
+        }
+    }
+
+    std::optional<UploadTicket> ticket = _uploader->UploadAsync();
+
+    // Forget requests that became resident since the last pump, IsResident reports unknown ids as resident.
+    std::erase_if(_stagedRequests, [this](const std::pair<uint64_t, UploadTicket>& stagedRequest) {
+        return _uploader->IsResident(stagedRequest.second);
+    });
+
+    // Fully staged requests stay queued until a submission carries them, a failed one keeps
+    // their copies in the uploader for the next pump.
+    if (ticket.has_value())
+    {
+        for (uint64_t requestId : _unsubmittedRequests)
+        {
+            _queuedRequests.erase(requestId);
+            _stagedRequests.emplace_back(requestId, ticket.value());
+        }
+
+        _unsubmittedRequests.clear();
+    }
+
+    return ticket;
+}
+
+bool UploadQueue::IsResident(UploadRequestId request)
+{
+    if (_queuedRequests.contains(request.Id))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < _stagedRequests.size(); i++)
+    {
+        if (_stagedRequests[i].first == request.Id)
+        {
+            if (!_uploader->IsResident(_stagedRequests[i].second))
+            {
+                return false;
+            }
+
+            _stagedRequests.erase(_stagedRequests.begin() + i);
+            break;
+        }
+    }
+
+    return true;
+}
+
+void UploadQueue::Cancel(UploadRequestId request)
+{
+    if (_queuedRequests.erase(request.Id) > 0)
+    {
+        for (std::deque<UploadRequest>& requests : _requests)
+        {
+            std::erase_if(requests, [request](const UploadRequest& queuedRequest) { return queuedRequest.Id == request.Id; });
+        }
+
+        std::erase(_unsubmittedRequests, request.Id);
+    }
+
+    std::erase_if(_stagedRequests, [request](const std::pair<uint64_t, UploadTicket>& stagedRequest) {
+        return stagedRequest.first == request.Id;
+    });
+}
+
+bool UploadQueue::IsEmpty() const
+{
+    return _queuedRequests.empty();
+}
+
+uint64_t UploadQueue::GetQueuedBytes() const
+{
+    uint64_t queuedBytes = 0;
+
+    for (const std::deque<UploadRequest>& requests : _requests)
+    {
+        for (const UploadRequest& request : requests)
+        {
+            queuedBytes += GetRemainingBytes(request);
+        }
+    }
+
+    return queuedBytes;
+}
+
+UploadWorker::UploadWorker(SDL_GPUDevice* graphicsDevice, uint32_t stagingSize)
+    : _uploader(graphicsDevice, stagingSize)
+{
+
+}
+
+bool UploadWorker::Start()
+{
+    _wakeSemaphore = SDL_CreateSemaphore(0);
+
+    if (_wakeSemaphore == NULL)
+    {
+        SDL_Log("Failed to create semaphore: %s", SDL_GetError());
+        return false;
+    }
+
+    _isRunning = true;
+    _thread = SDL_CreateThread(Run, "UploadWorker", this);
+
+    if (_thread == NULL)
+    {
+        SDL_Log("Failed to create upload thread: %s", SDL_GetError());
+        _isRunning = false;
+        return false;
+    }
+
+    return true;
+}
+
+std::optional<UploadRequestId> UploadWorker::SubmitBufferData(const void* data, uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset)
+{
+    return Submit(UploadJob{
+        .Data = data,
+        .Buffer = buffer,
+        .BufferOffset = bufferOffset,
+        .Size = size,
+    });
+}
+
+std::optional<UploadRequestId> UploadWorker::SubmitTextureData(const void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format, bool generateMipmaps)
+{
+    return Submit(UploadJob{
+        .Data = pixels,
+        .Texture = TextureUploadRegion{ .Texture = texture, .Format = format, .Width = width, .Height = height },
+        .GenerateMipmaps = generateMipmaps,
+    });
+}
+
+std::optional<UploadRequestId> UploadWorker::SubmitTextureSubresource(const void* pixels, const TextureUploadRegion& region, uint32_t pixelsPerRow)
+{
+    return Submit(UploadJob{
+        .Data = pixels,
+        .Texture = region,
+        .PixelsPerRow = pixelsPerRow,
+    });
+}
+
+std::optional<UploadRequestId> UploadWorker::Submit(UploadJob&& job)
+{
+    UploadRequestId request = { _nextRequestId };
+    job.Id = request.Id;
+
+    if (!_jobs.Push(std::move(job)))
+    {
+        return std::nullopt;
+    }
+
+    _nextRequestId++;
+    SDL_SignalSemaphore(_wakeSemaphore);
+
+    return request;
+}
+
+bool UploadWorker::IsResident(UploadRequestId request) const
+{
+    return request.Id <= _residentId.load(std::memory_order_acquire);
+}
+
+std::optional<UploadRequestId> UploadWorker::PollResident()
+{
+    std::optional<uint64_t> id = _residentJobs.Pop();
+
+    if (!id.has_value())
+    {
+        return std::nullopt;
+    }
+
+    return UploadRequestId{ id.value() };
+}
+
+int UploadWorker::Run(void* data)
+{
+    ((UploadWorker*) data)->ProcessJobs();
+
+    return 0;
+}
+
+void UploadWorker::ProcessJobs()
+{
+    std::deque<std::pair<uint64_t, UploadTicket>> submittedJobs;
+    std::deque<uint64_t> residentJobs;
+
+    // Last job whose copies are still waiting in the uploader for a successful submit.
+    uint64_t lastJobId = 0;
+
+    // Job that could not be staged, it goes first next time so jobs stay in order.
+    std::optional<UploadJob> stalledJob;
+
+    while (true)
+    {
+        bool isRunning = _isRunning.load(std::memory_order_acquire);
+
+        while (std::optional<UploadJob> job = stalledJob.has_value() ? std::move(stalledJob) : _jobs.Pop())
+        {
+            stalledJob.reset();
+
+            bool isStaged = job->Texture.has_value()
+                ? _uploader.AddTextureSubresource(job->Data, job->Texture.value(), job->PixelsPerRow)
+                : _uploader.AddBufferData(job->Data, job->Size, job->Buffer, job->BufferOffset);
+
+            if (!isStaged)
+            {
+                stalledJob = std::move(job);
+                break;
+            }
+
+            if (job->Texture.has_value() && job->GenerateMipmaps)
+            {
+                _uploader.GenerateMipmaps(job->Texture->Texture);
+            }
+
+            lastJobId = job->Id;
+        }
+
+        if (lastJobId != 0)
+        {
+            std::optional<UploadTicket> ticket = _uploader.UploadAsync();
+
+            // A failed submit keeps the copies in the uploader, so they are retried on the next iteration.
+            if (ticket.has_value())
+            {
+                submittedJobs.push_back({ lastJobId, ticket.value() });
+                lastJobId = 0;
+            }
+        }
+
+        if (!isRunning)
+        {
+            break;
+        }
+
+        while (!submittedJobs.empty() && _uploader.IsResident(submittedJobs.front().second))
+        {
+            uint64_t residentId = _residentId.load(std::memory_order_relaxed);
+
+            for (uint64_t id = residentId + 1; id <= submittedJobs.front().first; id++)
+            {
+                residentJobs.push_back(id);
+            }
+
+            _residentId.store(submittedJobs.front().first, std::memory_order_release);
+            submittedJobs.pop_front();
+        }
+
+        // Notifications wait here while the render thread has not drained the queue.
+        while (!residentJobs.empty() && _residentJobs.Push(std::move(residentJobs.front())))
+        {
+            residentJobs.pop_front();
+        }
+
+        // Poll the fences every millisecond while copies are in flight or waiting for a retry,
+        // sleep otherwise.
+        if (submittedJobs.empty() && residentJobs.empty() && lastJobId == 0 && !stalledJob.has_value())
+        {
+            SDL_WaitSemaphore(_wakeSemaphore);
+        }
+        else
+        {
+            SDL_WaitSemaphoreTimeout(_wakeSemaphore, 1);
+        }
+    }
+}
+
+void UploadWorker::Release()
+{
+    if (_thread != NULL)
+    {
+        _isRunning.store(false, std::memory_order_release);
+        SDL_SignalSemaphore(_wakeSemaphore);
+        SDL_WaitThread(_thread, NULL);
+        _thread = NULL;
+    }
+
+    if (_wakeSemaphore != NULL)
+    {
+        SDL_DestroySemaphore(_wakeSemaphore);
+        _wakeSemaphore = NULL;
+    }
+
+    _uploader.Release();
+}
+
+UploadCache::UploadCache(SDL_GPUDevice* graphicsDevice, GPUUploader* uploader)
+    : _graphicsDevice(graphicsDevice), _uploader(uploader)
+{
+
+}
+
+void* UploadCache::Find(const CacheKey& key, const void* data)
+{
+    auto [first, last] = _entries.equal_range(key);
+
+    for (auto entry = first; entry != last; entry++)
+    {
+        // The hash only narrows the search down, the bytes decide.
+        if (SDL_memcmp(entry->second.Contents.data(), data, entry->second.Contents.size()) == 0)
+        {
+            entry->second.ReferenceCount++;
+            return entry->second.Resource;
+        }
+    }
+
+    return nullptr;
+}
+
+void UploadCache::Insert(const CacheKey& key, void* resource, bool isTexture, const void* data)
+{
+    const uint8_t* bytes = (const uint8_t*) data;
+    uint64_t size = std::get<1>(key);
+
+    auto entry = _entries.emplace(key, CacheEntry{ .Resource = resource, .IsTexture = isTexture, .ReferenceCount = 1, .Contents = std::vector<uint8_t>(bytes, bytes + size) });
+    _resources[resource] = entry;
+}
+
+SDL_GPUBuffer* UploadCache::AcquireBuffer(const void* data, uint32_t size, SDL_GPUBufferUsageFlags usage)
+{
+    CacheKey key = { HashBytes(data, size), size, usage, 0, 0, 0 };
+
+    if (void* buffer = Find(key, data))
+    {
+        return (SDL_GPUBuffer*) buffer;
+    }
+
+    SDL_GPUBufferCreateInfo bufferInfo = { .usage = usage, .size = size };
+    SDL_GPUBuffer* buffer = SDL_CreateGPUBuffer(_graphicsDevice, &bufferInfo);
+
+    if (buffer == NULL)
+    {
+        SDL_Log("Failed to create buffer: %s", SDL_GetError());
+        return nullptr;
+    }
+
+    _uploader->AddBufferData(data, size, buffer);
+
+    Insert(key, buffer, false, data);
+
+    return buffer;
+}
+
+SDL_GPUTexture* UploadCache::AcquireTexture(const void* pixels, uint32_t width, uint32_t height, SDL_GPUTextureFormat format, bool generateMipmaps)
+{
+    uint64_t size = GetTextureSubresourceSize(format, width, height);
+    uint32_t levelCount = generateMipmaps ? GetMipLevelCount(width, height) : 1;
+    CacheKey key = { HashBytes(pixels, size), size, format, width, height, levelCount };
+
+    if (void* texture = Find(key, pixels))
+    {
+        return (SDL_GPUTexture*) texture;
+    }
+
+    SDL_GPUTextureCreateInfo textureInfo = {
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = format,
+        .usage = generateMipmaps ? SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET : SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .width = width,
+        .height = height,
+        .layer_count_or_depth = 1,
+        .num_levels = levelCount,
+    };
+
+    SDL_GPUTexture* texture = SDL_CreateGPUTexture(_graphicsDevice, &textureInfo);
+
+    if (texture == NULL)
+    {
+        SDL_Log("Failed to create texture: %s", SDL_GetError());
+        return nullptr;
+    }
+
+    _uploader->AddTextureData((void*) pixels, width, height, texture, format);
+
+    if (generateMipmaps)
+    {
+        _uploader->GenerateMipmaps(texture);
+    }
+
+    Insert(key, texture, true, pixels);
+
+    return texture;
+}
+
+void UploadCache::ReleaseBuffer(SDL_GPUBuffer* buffer)
+{
+    ReleaseResource(buffer);
+}
+
+void UploadCache::ReleaseTexture(SDL_GPUTexture* texture)
+{
+    ReleaseResource(texture);
+}
+
+void UploadCache::ReleaseResource(void* resource)
+{
+    auto resourceEntry = _resources.find(resource);
+
+    if (resourceEntry == _resources.end())
+    {
+        SDL_Log("Released a resource that is not owned by the upload cache");
+        return;
+    }
+
+    CacheEntry& entry = resourceEntry->second->second;
+
+    if (--entry.ReferenceCount > 0)
+    {
+        return;
+    }
+
+    if (entry.IsTexture)
+    {
+        SDL_ReleaseGPUTexture(_graphicsDevice, (SDL_GPUTexture*) resource);
+    }
+    else
+    {
+        SDL_ReleaseGPUBuffer(_graphicsDevice, (SDL_GPUBuffer*) resource);
+    }
+
+    _entries.erase(resourceEntry->second);
+    _resources.erase(resourceEntry);
+}
+
+void UploadCache::Release()
+{
+    for (auto& [key, entry] : _entries)
+    {
+        if (entry.IsTexture)
+        {
+            SDL_ReleaseGPUTexture(_graphicsDevice, (SDL_GPUTexture*) entry.Resource);
+        }
+        else
+        {
+            SDL_ReleaseGPUBuffer(_graphicsDevice, (SDL_GPUBuffer*) entry.Resource);
+        }
+    }
+
+    _entries.clear();
+    _resources.clear();
+}
+
+struct ParallelForContext
+{
+    const std::function<void(size_t)>* Body;
+    size_t Count;
+    std::atomic<size_t> NextIndex = 0;
+};
+
+static int RunParallelFor(void* data)
+{
+    ParallelForContext* context = (ParallelForContext*) data;
+
+    for (size_t i = context->NextIndex++; i < context->Count; i = context->NextIndex++)
+    {
+        (*context->Body)(i);
+    }
+
+    return 0;
+}
+
+void ParallelFor(size_t count, const std::function<void(size_t)>& body, uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = (uint32_t) std::max(SDL_GetNumLogicalCPUCores(), 1);
+    }
+
+    ParallelForContext context = { .Body = &body, .Count = count };
+    std::vector<SDL_Thread*> threads;
+
+    // The calling thread works too, so one thread fewer is started.
+    for (size_t i = 1; i < std::min<size_t>(threadCount, count); i++)
+    {
+        SDL_Thread* thread = SDL_CreateThread(RunParallelFor, "ParallelFor", &context);
+
+        if (thread == NULL)
+        {
+            SDL_Log("Failed to create worker thread: %s", SDL_GetError());
+            break;
+        }
+
+        threads.push_back(thread);
+    }
+
+    RunParallelFor(&context);
+
+    for (SDL_Thread* thread : threads)
+    {
+        SDL_WaitThread(thread, NULL);
+    }
+}
+
+// MurmurHash64A, reads eight bytes at a time.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const uint64_t Multiplier = 0xc6a4a7935bd1e995ull;
+    const int32_t Shift = 47;
+
+    const uint8_t* bytes = (const uint8_t*) data;
+    const uint8_t* end = bytes + (size & ~(size_t) 7);
+
+    uint64_t hash = seed ^ (size * Multiplier);
+
+    for (; bytes != end; bytes += 8)
+    {
+        uint64_t word;
+        SDL_memcpy(&word, bytes, sizeof(word));
+
+        word *= Multiplier;
+        word ^= word >> Shift;
+        word *= Multiplier;
+
+        hash ^= word;
+        hash *= Multiplier;
+    }
+
+    size_t remaining = size & 7;
+
+    if (remaining > 0)
+    {
+        uint64_t word = 0;
+        SDL_memcpy(&word, bytes, remaining);
+
+        hash ^= word;
+        hash *= Multiplier;
+    }
+
+    hash ^= hash >> Shift;
+    hash *= Multiplier;
+    hash ^= hash >> Shift;
+
+    return hash;
+}
+
+uint32_t GetTextureFormatBlockExtent(SDL_GPUTextureFormat format)
+{
+    switch (format)
+    {
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC4_R_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC6H_RGB_FLOAT:
+    case SDL_GPU_TEXTUREFORMAT_BC6H_RGB_UFLOAT:
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC2_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+uint64_t GetTextureSubresourceSize(SDL_GPUTextureFormat format, uint32_t width, uint32_t height, uint32_t depth)
+{
+    uint32_t blockExtent = GetTextureFormatBlockExtent(format);
+    uint64_t blocksPerRow = (width + blockExtent - 1) / blockExtent;
+    uint64_t blockRows = (height + blockExtent - 1) / blockExtent;
+
+    return blocksPerRow * blockRows * depth * SDL_GPUTextureFormatTexelBlockSize(format);
+}
+
+uint64_t GetMipChainSize(SDL_GPUTextureFormat format, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+    uint64_t size = 0;
+
+    for (uint32_t mipLevel = 0; mipLevel < levelCount; mipLevel++)
+    {
+        size += GetTextureSubresourceSize(format, std::max(width >> mipLevel, 1u), std::max(height >> mipLevel, 1u));
+    }
+
+    return size;
+}
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levelCount = 1;
+
+    while ((width | height) >> levelCount)
+    {
+        levelCount++;
+    }
+
+    return levelCount;
+}
+
+std::string GetBakedTextureFallbackPath(const std::string& filePath)
+{
+    std::string extension = ".tex";
+    std::string basePath = filePath.ends_with(extension) ? filePath.substr(0, filePath.size() - extension.size()) : filePath;
+
+    return basePath + ".rgba8" + extension;
+}
+
+static std::optional<BakedTextureHeader> ReadBakedTextureHeader(std::span<const uint8_t> textureData, const std::string& filePath)
+{
+    BakedTextureHeader header;
+
+    if (textureData.size() < sizeof(header))
+    {
+        SDL_Log("Baked texture %s is truncated", filePath.c_str());
+        return std::nullopt;
+    }
+
+    SDL_memcpy(&header, textureData.data(), sizeof(header));
+
+    SDL_GPUTextureFormat format = (SDL_GPUTextureFormat) header.Format;
+
+    if (header.Magic != BakedTextureHeader::ExpectedMagic || header.Version != BakedTextureHeader::CurrentVersion
+        || header.LevelCount == 0 || header.LevelCount > GetMipLevelCount(header.Width, header.Height)
+        || header.DataSize != GetMipChainSize(format, header.Width, header.Height, header.LevelCount)
+        || textureData.size() - sizeof(header) < header.DataSize)
+    {
+        SDL_Log("%s is not a valid baked texture", filePath.c_str());
+        return std::nullopt;
+    }
+
+    return header;
+}
+
+// Maps a baked texture and validates its header. When the GPU can't sample its format,
+// the RGBA8 copy baked next to it is mapped instead.
+static std::optional<AssetFile> OpenBakedTexture(SDL_GPUDevice* graphicsDevice, const std::string& filePath, BakedTextureHeader& header)
+{
+    std::string path = filePath;
+
+    for (int32_t attempt = 0; attempt < 2; attempt++)
+    {
+        std::optional<AssetFile> textureFile = AssetFile::Open(path);
+
+        if (textureFile == std::nullopt)
+        {
+            return std::nullopt;
+        }
+
+        std::optional<BakedTextureHeader> fileHeader = ReadBakedTextureHeader(textureFile->GetData(), path);
+
+        if (fileHeader == std::nullopt)
+        {
+            textureFile->Release();
+            return std::nullopt;
+        }
+
+        if (SDL_GPUTextureSupportsFormat(graphicsDevice, (SDL_GPUTextureFormat) fileHeader->Format, SDL_GPU_TEXTURETYPE_2D, SDL_GPU_TEXTUREUSAGE_SAMPLER))
+        {
+            header = *fileHeader;
+            return textureFile;
+        }
+
+        SDL_Log("Baked texture %s uses format %u, which the GPU can not sample", path.c_str(), fileHeader->Format);
+        textureFile->Release();
+
+        if (fileHeader->Format == SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM)
+        {
+            break;
+        }
+
+        path = GetBakedTextureFallbackPath(filePath);
+    }
+
+    return std::nullopt;
+}
+
+static SDL_GPUTexture* CreateBakedTexture(SDL_GPUDevice* graphicsDevice, const BakedTextureHeader& header)
+{
+    SDL_GPUTextureCreateInfo textureInfo = {
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = (SDL_GPUTextureFormat) header.Format,
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .width = header.Width,
+        .height = header.Height,
+        .layer_count_or_depth = 1,
+        .num_levels = header.LevelCount,
+    };
+
+    SDL_GPUTexture* texture = SDL_CreateGPUTexture(graphicsDevice, &textureInfo);
+
+    if (texture == NULL)
+    {
+        SDL_Log("Failed to create texture: %s", SDL_GetError());
+    }
+
+    return texture;
+}
+
+SDL_GPUTexture* LoadBakedTexture(SDL_GPUDevice* graphicsDevice, GPUUploader& uploader, const std::string& filePath)
+{
+    BakedTextureHeader header;
+    std::optional<AssetFile> textureFile = OpenBakedTexture(graphicsDevice, filePath, header);
+
+    if (textureFile == std::nullopt)
+    {
+        return nullptr;
+    }
+
+    std::span<const uint8_t> textureData = textureFile->GetData();
+    SDL_GPUTexture* texture = CreateBakedTexture(graphicsDevice, header);
+
+    if (texture == NULL)
+    {
+        textureFile->Release();
+        return nullptr;
+    }
+
+    // Staging takes its own copy, so the file can be unmapped right away.
+    uploader.AddTextureMipChain(textureData.data() + sizeof(BakedTextureHeader), header.Width, header.Height, header.LevelCount, texture, (SDL_GPUTextureFormat) header.Format);
+
+    textureFile->Release();
+
+    return texture;
+}
+
+StreamingTexture::StreamingTexture(SDL_GPUDevice* graphicsDevice, UploadQueue* uploadQueue, const AssetFile& textureFile, SDL_GPUTexture* texture, const SDL_GPUSamplerCreateInfo& samplerInfo)
+    : _graphicsDevice(graphicsDevice), _uploadQueue(uploadQueue), _textureFile(textureFile), _texture(texture), _samplerInfo(samplerInfo)
+{ }
+
+StreamingTexture::StreamingTexture(StreamingTexture&& other) noexcept
+    : _graphicsDevice(other._graphicsDevice), _uploadQueue(other._uploadQueue), _textureFile(other._textureFile), _texture(other._texture),
+      _samplerInfo(other._samplerInfo), _sampler(other._sampler), _residentMipLevel(other._residentMipLevel), _samplerMipLevel(other._samplerMipLevel),
+      _isFileMapped(other._isFileMapped), _pendingMips(std::move(other._pendingMips))
+{
+    other._texture = NULL;
+    other._sampler = NULL;
+    other._isFileMapped = false;
+    other._pendingMips.clear();
+}
+
+StreamingTexture& StreamingTexture::operator=(StreamingTexture&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+
+        _graphicsDevice = other._graphicsDevice;
+        _uploadQueue = other._uploadQueue;
+        _textureFile = other._textureFile;
+        _texture = other._texture;
+        _samplerInfo = other._samplerInfo;
+        _sampler = other._sampler;
+        _residentMipLevel = other._residentMipLevel;
+        _samplerMipLevel = other._samplerMipLevel;
+        _isFileMapped = other._isFileMapped;
+        _pendingMips = std::move(other._pendingMips);
+
+        other._texture = NULL;
+        other._sampler = NULL;
+        other._isFileMapped = false;
+        other._pendingMips.clear();
+    }
+
+    return *this;
+}
+
+std::optional<StreamingTexture> StreamingTexture::Open(SDL_GPUDevice* graphicsDevice, GPUUploader& uploader, UploadQueue& uploadQueue, const std::string& filePath, const SDL_GPUSamplerCreateInfo& samplerInfo, uint32_t initialSize, UploadPriority priority)
+{
+    BakedTextureHeader header;
+    std::optional<AssetFile> textureFile = OpenBakedTexture(graphicsDevice, filePath, header);
+
+    if (textureFile == std::nullopt)
+    {
+        return std::nullopt;
+    }
+
+    std::span<const uint8_t> textureData = textureFile->GetData();
+    SDL_GPUTexture* texture = CreateBakedTexture(graphicsDevice, header);
+
+    if (texture == NULL)
+    {
+        textureFile->Release();
+        return std::nullopt;
+    }
+
+    StreamingTexture streamingTexture(graphicsDevice, &uploadQueue, *textureFile, texture, samplerInfo);
+    SDL_GPUTextureFormat format = (SDL_GPUTextureFormat) header.Format;
+
+    std::vector<const uint8_t*> mips(header.LevelCount);
+    const uint8_t* mip = textureData.data() + sizeof(BakedTextureHeader);
+
+    for (uint32_t mipLevel = 0; mipLevel < header.LevelCount; mipLevel++)
+    {
+        mips[mipLevel] = mip;
+        mip += GetTextureSubresourceSize(format, std::max(header.Width >> mipLevel, 1u), std::max(header.Height >> mipLevel, 1u));
+    }
+
+    // The smallest mip always goes up right away, together with every other one that fits into initialSize.
+    uint32_t initialMipLevel = header.LevelCount - 1;
+
+    while (initialMipLevel > 0 && std::max(header.Width >> (initialMipLevel - 1), header.Height >> (initialMipLevel - 1)) <= initialSize)
+    {
+        initialMipLevel--;
+    }
+
+    // The sampler comes first, so a failure leaves nothing staged or queued that reads the texture or the file.
+    streamingTexture._residentMipLevel = initialMipLevel;
+
+    if (!streamingTexture.CreateSampler())
+    {
+        streamingTexture.Release();
+        return std::nullopt;
+    }
+
+    for (uint32_t mipLevel = header.LevelCount; mipLevel-- > 0;)
+    {
+        TextureUploadRegion region = {
+            .Texture = texture,
+            .Format = format,
+            .MipLevel = mipLevel,
+            .Width = std::max(header.Width >> mipLevel, 1u),
+            .Height = std::max(header.Height >> mipLevel, 1u),
+        };
+
+        // The rest are queued coarse to fine, so each one refines the texture as soon as it lands.
+        if (mipLevel >= initialMipLevel)
+        {
+            uploader.AddTextureSubresource(mips[mipLevel], region);
+        }
+        else
+        {
+            streamingTexture._pendingMips.push_back(PendingMip{ .MipLevel = mipLevel, .Request = uploadQueue.EnqueueTextureSubresource(mips[mipLevel], region, 0, priority) });
+        }
+    }
+
+    // Staging has copied every mip already when none had to be queued.
+    streamingTexture.Update();
+
+    return streamingTexture;
+}
+
+bool StreamingTexture::CreateSampler()
+{
+    SDL_GPUSamplerCreateInfo samplerInfo = _samplerInfo;
+    samplerInfo.min_lod = std::max(samplerInfo.min_lod, (float) _residentMipLevel);
+    samplerInfo.max_lod = std::max(samplerInfo.max_lod, samplerInfo.min_lod);
+
+    SDL_GPUSampler* sampler = SDL_CreateGPUSampler(_graphicsDevice, &samplerInfo);
+
+    if (sampler == NULL)
+    {
+        SDL_Log("Failed to create sampler: %s", SDL_GetError());
+        return false;
+    }
+
+    if (_sampler != NULL)
+    {
+        SDL_ReleaseGPUSampler(_graphicsDevice, _sampler);
+    }
+
+    _sampler = sampler;
+    _samplerMipLevel = _residentMipLevel;
+
+    return true;
+}
+
+void StreamingTexture::Update()
+{
+    while (!_pendingMips.empty() && _uploadQueue->IsResident(_pendingMips.front().Request))
+    {
+        _residentMipLevel = _pendingMips.front().MipLevel;
+        _pendingMips.pop_front();
+    }
+
+    // A sampler that fails to be created is tried again on the next update, meanwhile the
+    // previous one keeps sampling the coarser mips.
+    if (_samplerMipLevel != _residentMipLevel)
+    {
+        CreateSampler();
+    }
+
+    // Every mip is on the GPU, so the file is no longer needed.
+    if (_pendingMips.empty() && _isFileMapped)
+    {
+        _textureFile.Release();
+        _isFileMapped = false;
+    }
+}
+
+bool StreamingTexture::IsComplete() const
+{
+    return _pendingMips.empty();
+}
+
+uint32_t StreamingTexture::GetResidentMipLevel() const
+{
+    return _residentMipLevel;
+}
+
+SDL_GPUTexture* StreamingTexture::GetHandle() const
+{
+    return _texture;
+}
+
+SDL_GPUSampler* StreamingTexture::GetSampler() const
+{
+    return _sampler;
+}
+
+void StreamingTexture::Release()
+{
+    // Queued mips read from the mapped file, so they go before it is unmapped.
+    for (const PendingMip& pendingMip : _pendingMips)
+    {
+        _uploadQueue->Cancel(pendingMip.Request);
+    }
+
+    _pendingMips.clear();
+
+    if (_isFileMapped)
+    {
+        _textureFile.Release();
+        _isFileMapped = false;
+    }
+
+    if (_sampler != NULL)
+    {
+        SDL_ReleaseGPUSampler(_graphicsDevice, _sampler);
+        _sampler = NULL;
+    }
+
+    if (_texture != NULL)
+    {
+        SDL_ReleaseGPUTexture(_graphicsDevice, _texture);
+        _texture = NULL;
+    }
+}
+
+static void ConvertRgbToRgbaScalar(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        destination[i * 4 + 0] = source[i * 3 + 0];
+        destination[i * 4 + 1] = source[i * 3 + 1];
+        destination[i * 4 + 2] = source[i * 3 + 2];
+        destination[i * 4 + 3] = 255;
+    }
+}
+
+static void ConvertGrayToRgbaScalar(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        destination[i * 4 + 0] = source[i];
+        destination[i * 4 + 1] = source[i];
+        destination[i * 4 + 2] = source[i];
+        destination[i * 4 + 3] = 255;
+    }
+}
+
+static void ConvertGrayAlphaToRgbaScalar(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        destination[i * 4 + 0] = source[i * 2];
+        destination[i * 4 + 1] = source[i * 2];
+        destination[i * 4 + 2] = source[i * 2];
+        destination[i * 4 + 3] = source[i * 2 + 1];
+    }
+}
+
+static void ConvertGrayAlphaToGrayScalar(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        destination[i] = source[i * 2];
+    }
+}
+
+// Same weights as stb_image uses for luminance, out of 256.
+static const uint32_t LuminanceRed = 77;
+static const uint32_t LuminanceGreen = 150;
+static const uint32_t LuminanceBlue = 29;
+
+static void ConvertRgbToGrayScalar(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        destination[i] = (uint8_t) ((source[i * 3] * LuminanceRed + source[i * 3 + 1] * LuminanceGreen + source[i * 3 + 2] * LuminanceBlue) >> 8);
+    }
+}
+
+static void ConvertRgbaToGrayScalar(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        destination[i] = (uint8_t) ((source[i * 4] * LuminanceRed + source[i * 4 + 1] * LuminanceGreen + source[i * 4 + 2] * LuminanceBlue) >> 8);
+    }
+}
+
+static void PremultiplyAlphaScalar(uint8_t* pixels, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        uint32_t alpha = pixels[i * 4 + 3];
+
+        for (uint32_t channel = 0; channel < 3; channel++)
+        {
+            // Exact rounding of value * alpha / 255.
+            uint32_t product = pixels[i * 4 + channel] * alpha + 128;
+            pixels[i * 4 + channel] = (uint8_t) ((product + (product >> 8)) >> 8);
+        }
+    }
+}
+
+#if defined(COMMON_X86)
+TARGET_SSE41 static void ConvertRgbToRgbaSse41(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i alpha = _mm_set1_epi32((int32_t) 0xFF000000);
+    size_t i = 0;
+
+    // Each load reads 16 bytes for 4 pixels, so the last pixels are left to the scalar loop.
+    for (; i + 6 <= pixelCount; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*) (source + i * 3));
+        _mm_storeu_si128((__m128i*) (destination + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+    }
+
+    ConvertRgbToRgbaScalar(source + i * 3, destination + i * 4, pixelCount - i);
+}
+
+TARGET_SSE41 static void ConvertGrayToRgbaSse41(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m128i alpha = _mm_set1_epi8((char) 0xFF);
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        __m128i gray = _mm_loadu_si128((const __m128i*) (source + i));
+
+        __m128i grayGrayLow = _mm_unpacklo_epi8(gray, gray);
+        __m128i grayGrayHigh = _mm_unpackhi_epi8(gray, gray);
+        __m128i grayAlphaLow = _mm_unpacklo_epi8(gray, alpha);
+        __m128i grayAlphaHigh = _mm_unpackhi_epi8(gray, alpha);
+
+        _mm_storeu_si128((__m128i*) (destination + i * 4), _mm_unpacklo_epi16(grayGrayLow, grayAlphaLow));
+        _mm_storeu_si128((__m128i*) (destination + i * 4 + 16), _mm_unpackhi_epi16(grayGrayLow, grayAlphaLow));
+        _mm_storeu_si128((__m128i*) (destination + i * 4 + 32), _mm_unpacklo_epi16(grayGrayHigh, grayAlphaHigh));
+        _mm_storeu_si128((__m128i*) (destination + i * 4 + 48), _mm_unpackhi_epi16(grayGrayHigh, grayAlphaHigh));
+    }
+
+    ConvertGrayToRgbaScalar(source + i, destination + i * 4, pixelCount - i);
+}
+
+TARGET_SSE41 static void ConvertGrayAlphaToRgbaSse41(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m128i shuffleLow = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+    __m128i shuffleHigh = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+    size_t i = 0;
+
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*) (source + i * 2));
+
+        _mm_storeu_si128((__m128i*) (destination + i * 4), _mm_shuffle_epi8(pixels, shuffleLow));
+        _mm_storeu_si128((__m128i*) (destination + i * 4 + 16), _mm_shuffle_epi8(pixels, shuffleHigh));
+    }
+
+    ConvertGrayAlphaToRgbaScalar(source + i * 2, destination + i * 4, pixelCount - i);
+}
+
+TARGET_SSE41 static void ConvertGrayAlphaToGraySse41(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m128i grayMask = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        __m128i low = _mm_and_si128(_mm_loadu_si128((const __m128i*) (source + i * 2)), grayMask);
+        __m128i high = _mm_and_si128(_mm_loadu_si128((const __m128i*) (source + i * 2 + 16)), grayMask);
+
+        _mm_storeu_si128((__m128i*) (destination + i), _mm_packus_epi16(low, high));
+    }
+
+    ConvertGrayAlphaToGrayScalar(source + i * 2, destination + i, pixelCount - i);
+}
+
+// Luminance of four RGBX pixels as 32-bit values, the fourth channel is ignored.
+TARGET_SSE41 static __m128i LuminanceSse41(__m128i pixels)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i weights = _mm_setr_epi16(LuminanceRed, LuminanceGreen, LuminanceBlue, 0, LuminanceRed, LuminanceGreen, LuminanceBlue, 0);
+
+    __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+    __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+
+    return _mm_srli_epi32(_mm_hadd_epi32(low, high), 8);
+}
+
+// Packs the luminance of sixteen pixels, four at a time, into bytes.
+TARGET_SSE41 static __m128i PackLuminanceSse41(__m128i first, __m128i second, __m128i third, __m128i fourth)
+{
+    return _mm_packus_epi16(_mm_packs_epi32(first, second), _mm_packs_epi32(third, fourth));
+}
+
+TARGET_SSE41 static void ConvertRgbToGraySse41(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t i = 0;
+
+    // The last of the four loads reads 16 bytes from byte 36.
+    for (; i + 18 <= pixelCount; i += 16)
+    {
+        const uint8_t* rgb = source + i * 3;
+
+        __m128i first = LuminanceSse41(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) rgb), shuffle));
+        __m128i second = LuminanceSse41(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (rgb + 12)), shuffle));
+        __m128i third = LuminanceSse41(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (rgb + 24)), shuffle));
+        __m128i fourth = LuminanceSse41(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (rgb + 36)), shuffle));
+
+        _mm_storeu_si128((__m128i*) (destination + i), PackLuminanceSse41(first, second, third, fourth));
+    }
+
+    ConvertRgbToGrayScalar(source + i * 3, destination + i, pixelCount - i);
+}
+
+TARGET_SSE41 static void ConvertRgbaToGraySse41(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        const uint8_t* rgba = source + i * 4;
+
+        __m128i first = LuminanceSse41(_mm_loadu_si128((const __m128i*) rgba));
+        __m128i second = LuminanceSse41(_mm_loadu_si128((const __m128i*) (rgba + 16)));
+        __m128i third = LuminanceSse41(_mm_loadu_si128((const __m128i*) (rgba + 32)));
+        __m128i fourth = LuminanceSse41(_mm_loadu_si128((const __m128i*) (rgba + 48)));
+
+        _mm_storeu_si128((__m128i*) (destination + i), PackLuminanceSse41(first, second, third, fourth));
+    }
+
+    ConvertRgbaToGrayScalar(source + i * 4, destination + i, pixelCount - i);
+}
+
+// Multiplies eight 16-bit values by eight alphas with the same rounding as the scalar loop.
+TARGET_SSE41 static __m128i MultiplyAlphaSse41(__m128i values, __m128i alphas)
+{
+    __m128i product = _mm_add_epi16(_mm_mullo_epi16(values, alphas), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+TARGET_SSE41 static void PremultiplyAlphaSse41(uint8_t* pixels, size_t pixelCount)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i alphaMask = _mm_set1_epi32((int32_t) 0xFF000000);
+    size_t i = 0;
+
+    for (; i + 4 <= pixelCount; i += 4)
+    {
+        __m128i rgba = _mm_loadu_si128((const __m128i*) (pixels + i * 4));
+
+        __m128i low = _mm_unpacklo_epi8(rgba, zero);
+        __m128i high = _mm_unpackhi_epi8(rgba, zero);
+        __m128i lowAlphas = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i highAlphas = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128i result = _mm_packus_epi16(MultiplyAlphaSse41(low, lowAlphas), MultiplyAlphaSse41(high, highAlphas));
+
+        // Alpha itself stays as it was.
+        _mm_storeu_si128((__m128i*) (pixels + i * 4), _mm_blendv_epi8(result, rgba, alphaMask));
+    }
+
+    PremultiplyAlphaScalar(pixels + i * 4, pixelCount - i);
+}
+
+TARGET_AVX2 static void ConvertRgbToRgbaAvx2(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i alpha = _mm256_set1_epi32((int32_t) 0xFF000000);
+    size_t i = 0;
+
+    // The second load of each 8 pixels reads 16 bytes from byte 12.
+    for (; i + 10 <= pixelCount; i += 8)
+    {
+        __m128i low = _mm_loadu_si128((const __m128i*) (source + i * 3));
+        __m128i high = _mm_loadu_si128((const __m128i*) (source + i * 3 + 12));
+        __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+
+        _mm256_storeu_si256((__m256i*) (destination + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+    }
+
+    ConvertRgbToRgbaSse41(source + i * 3, destination + i * 4, pixelCount - i);
+}
+
+TARGET_AVX2 static void ConvertGrayToRgbaAvx2(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m256i alpha = _mm256_set1_epi32((int32_t) 0xFF000000);
+    __m256i spread = _mm256_set1_epi32(0x00010101);
+    size_t i = 0;
+
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m256i gray = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (source + i)));
+        _mm256_storeu_si256((__m256i*) (destination + i * 4), _mm256_or_si256(_mm256_mullo_epi32(gray, spread), alpha));
+    }
+
+    ConvertGrayToRgbaScalar(source + i, destination + i * 4, pixelCount - i);
+}
+
+TARGET_AVX2 static void ConvertGrayAlphaToRgbaAvx2(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m256i shuffle = _mm256_setr_epi8(
+        0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7,
+        8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+    size_t i = 0;
+
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m256i pixels = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (source + i * 2)));
+        _mm256_storeu_si256((__m256i*) (destination + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+    }
+
+    ConvertGrayAlphaToRgbaScalar(source + i * 2, destination + i * 4, pixelCount - i);
+}
+
+TARGET_AVX2 static void ConvertGrayAlphaToGrayAvx2(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    __m256i grayMask = _mm256_set1_epi16(0x00FF);
+    size_t i = 0;
+
+    for (; i + 32 <= pixelCount; i += 32)
+    {
+        __m256i low = _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (source + i * 2)), grayMask);
+        __m256i high = _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (source + i * 2 + 32)), grayMask);
+
+        // Packing works within 128-bit lanes, so the quarters come out as 0, 2, 1, 3.
+        __m256i gray = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*) (destination + i), gray);
+    }
+
+    ConvertGrayAlphaToGrayScalar(source + i * 2, destination + i, pixelCount - i);
+}
+
+TARGET_AVX2 static __m256i LuminanceAvx2(__m256i pixels)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i weights = _mm256_setr_epi16(
+        LuminanceRed, LuminanceGreen, LuminanceBlue, 0, LuminanceRed, LuminanceGreen, LuminanceBlue, 0,
+        LuminanceRed, LuminanceGreen, LuminanceBlue, 0, LuminanceRed, LuminanceGreen, LuminanceBlue, 0);
+
+    // Unpacking and adding both work within 128-bit lanes, so pixels keep their order.
+    __m256i low = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero), weights);
+    __m256i high = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero), weights);
+
+    return _mm256_srli_epi32(_mm256_hadd_epi32(low, high), 8);
+}
+
+TARGET_AVX2 static __m256i PackLuminanceAvx2(__m256i first, __m256i second, __m256i third, __m256i fourth)
+{
+    __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(first, second), _mm256_packs_epi32(third, fourth));
+
+    // Packing interleaves the lanes, each 32-bit value holds four pixels of one input.
+    return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+TARGET_AVX2 static __m256i LoadRgbAsRgbxAvx2(const uint8_t* source)
+{
+    __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+    __m128i low = _mm_loadu_si128((const __m128i*) source);
+    __m128i high = _mm_loadu_si128((const __m128i*) (source + 12));
+
+    return _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), shuffle);
+}
+
+TARGET_AVX2 static void ConvertRgbToGrayAvx2(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    // The last load reads 16 bytes from byte 84.
+    for (; i + 34 <= pixelCount; i += 32)
+    {
+        const uint8_t* rgb = source + i * 3;
+
+        __m256i first = LuminanceAvx2(LoadRgbAsRgbxAvx2(rgb));
+        __m256i second = LuminanceAvx2(LoadRgbAsRgbxAvx2(rgb + 24));
+        __m256i third = LuminanceAvx2(LoadRgbAsRgbxAvx2(rgb + 48));
+        __m256i fourth = LuminanceAvx2(LoadRgbAsRgbxAvx2(rgb + 72));
+
+        _mm256_storeu_si256((__m256i*) (destination + i), PackLuminanceAvx2(first, second, third, fourth));
+    }
+
+    ConvertRgbToGraySse41(source + i * 3, destination + i, pixelCount - i);
+}
+
+TARGET_AVX2 static void ConvertRgbaToGrayAvx2(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= pixelCount; i += 32)
+    {
+        const uint8_t* rgba = source + i * 4;
+
+        __m256i first = LuminanceAvx2(_mm256_loadu_si256((const __m256i*) rgba));
+        __m256i second = LuminanceAvx2(_mm256_loadu_si256((const __m256i*) (rgba + 32)));
+        __m256i third = LuminanceAvx2(_mm256_loadu_si256((const __m256i*) (rgba + 64)));
+        __m256i fourth = LuminanceAvx2(_mm256_loadu_si256((const __m256i*) (rgba + 96)));
+
+        _mm256_storeu_si256((__m256i*) (destination + i), PackLuminanceAvx2(first, second, third, fourth));
+    }
+
+    ConvertRgbaToGraySse41(source + i * 4, destination + i, pixelCount - i);
+}
+
+TARGET_AVX2 static __m256i MultiplyAlphaAvx2(__m256i values, __m256i alphas)
+{
+    __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(values, alphas), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+}
+
+TARGET_AVX2 static void PremultiplyAlphaAvx2(uint8_t* pixels, size_t pixelCount)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i alphaMask = _mm256_set1_epi32((int32_t) 0xFF000000);
+    size_t i = 0;
+
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m256i rgba = _mm256_loadu_si256((const __m256i*) (pixels + i * 4));
+
+        // Unpacking and packing both work within 128-bit lanes, so pixels keep their order.
+        __m256i low = _mm256_unpacklo_epi8(rgba, zero);
+        __m256i high = _mm256_unpackhi_epi8(rgba, zero);
+        __m256i lowAlphas = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(low, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i highAlphas = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(high, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m256i result = _mm256_packus_epi16(MultiplyAlphaAvx2(low, lowAlphas), MultiplyAlphaAvx2(high, highAlphas));
+        _mm256_storeu_si256((__m256i*) (pixels + i * 4), _mm256_blendv_epi8(result, rgba, alphaMask));
+    }
+
+    PremultiplyAlphaSse41(pixels + i * 4, pixelCount - i);
+}
+#elif defined(COMMON_NEON)
+static void ConvertRgbToRgbaNeon(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x3_t rgb = vld3q_u8(source + i * 3);
+        uint8x16x4_t rgba = { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255) };
+        vst4q_u8(destination + i * 4, rgba);
+    }
+
+    ConvertRgbToRgbaScalar(source + i * 3, destination + i * 4, pixelCount - i);
+}
+
+static void ConvertGrayToRgbaNeon(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16_t gray = vld1q_u8(source + i);
+        uint8x16x4_t rgba = { gray, gray, gray, vdupq_n_u8(255) };
+        vst4q_u8(destination + i * 4, rgba);
+    }
+
+    ConvertGrayToRgbaScalar(source + i, destination + i * 4, pixelCount - i);
+}
+
+static void ConvertGrayAlphaToRgbaNeon(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x2_t grayAlpha = vld2q_u8(source + i * 2);
+        uint8x16x4_t rgba = { grayAlpha.val[0], grayAlpha.val[0], grayAlpha.val[0], grayAlpha.val[1] };
+        vst4q_u8(destination + i * 4, rgba);
+    }
+
+    ConvertGrayAlphaToRgbaScalar(source + i * 2, destination + i * 4, pixelCount - i);
+}
+
+static void ConvertGrayAlphaToGrayNeon(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        vst1q_u8(destination + i, vld2q_u8(source + i * 2).val[0]);
+    }
+
+    ConvertGrayAlphaToGrayScalar(source + i * 2, destination + i, pixelCount - i);
+}
+
+static uint8x16_t LuminanceNeon(uint8x16_t red, uint8x16_t green, uint8x16_t blue)
+{
+    uint16x8_t low = vmull_u8(vget_low_u8(red), vdup_n_u8(LuminanceRed));
+    low = vmlal_u8(low, vget_low_u8(green), vdup_n_u8(LuminanceGreen));
+    low = vmlal_u8(low, vget_low_u8(blue), vdup_n_u8(LuminanceBlue));
+
+    uint16x8_t high = vmull_u8(vget_high_u8(red), vdup_n_u8(LuminanceRed));
+    high = vmlal_u8(high, vget_high_u8(green), vdup_n_u8(LuminanceGreen));
+    high = vmlal_u8(high, vget_high_u8(blue), vdup_n_u8(LuminanceBlue));
+
+    return vcombine_u8(vshrn_n_u16(low, 8), vshrn_n_u16(high, 8));
+}
+
+static void ConvertRgbToGrayNeon(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x3_t rgb = vld3q_u8(source + i * 3);
+        vst1q_u8(destination + i, LuminanceNeon(rgb.val[0], rgb.val[1], rgb.val[2]));
+    }
+
+    ConvertRgbToGrayScalar(source + i * 3, destination + i, pixelCount - i);
+}
+
+static void ConvertRgbaToGrayNeon(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x4_t rgba = vld4q_u8(source + i * 4);
+        vst1q_u8(destination + i, LuminanceNeon(rgba.val[0], rgba.val[1], rgba.val[2]));
+    }
+
+    ConvertRgbaToGrayScalar(source + i * 4, destination + i, pixelCount - i);
+}
+
+// Rounds value * alpha / 255 exactly, like the scalar loop.
+static uint8x16_t MultiplyAlphaNeon(uint8x16_t values, uint8x16_t alphas)
+{
+    uint16x8_t low = vmull_u8(vget_low_u8(values), vget_low_u8(alphas));
+    uint16x8_t high = vmull_u8(vget_high_u8(values), vget_high_u8(alphas));
+
+    return vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+}
+
+static void PremultiplyAlphaNeon(uint8_t* pixels, size_t pixelCount)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x4_t rgba = vld4q_u8(pixels + i * 4);
+
+        rgba.val[0] = MultiplyAlphaNeon(rgba.val[0], rgba.val[3]);
+        rgba.val[1] = MultiplyAlphaNeon(rgba.val[1], rgba.val[3]);
+        rgba.val[2] = MultiplyAlphaNeon(rgba.val[2], rgba.val[3]);
+
+        vst4q_u8(pixels + i * 4, rgba);
+    }
+
+    PremultiplyAlphaScalar(pixels + i * 4, pixelCount - i);
+}
+#endif
+
+struct PixelKernels
+{
+    void (*RgbToRgba)(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+    void (*GrayToRgba)(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+    void (*GrayAlphaToRgba)(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+    void (*GrayAlphaToGray)(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+    void (*RgbToGray)(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+    void (*RgbaToGray)(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+    void (*PremultiplyAlpha)(uint8_t* pixels, size_t pixelCount);
+};
+
+static PixelKernels SelectPixelKernels()
+{
+#if defined(COMMON_X86)
+    if (SDL_HasAVX2())
+    {
+        return { ConvertRgbToRgbaAvx2, ConvertGrayToRgbaAvx2, ConvertGrayAlphaToRgbaAvx2, ConvertGrayAlphaToGrayAvx2, ConvertRgbToGrayAvx2, ConvertRgbaToGrayAvx2, PremultiplyAlphaAvx2 };
+    }
+
+    if (SDL_HasSSE41())
+    {
+        return { ConvertRgbToRgbaSse41, ConvertGrayToRgbaSse41, ConvertGrayAlphaToRgbaSse41, ConvertGrayAlphaToGraySse41, ConvertRgbToGraySse41, ConvertRgbaToGraySse41, PremultiplyAlphaSse41 };
+    }
+#elif defined(COMMON_NEON)
+    return { ConvertRgbToRgbaNeon, ConvertGrayToRgbaNeon, ConvertGrayAlphaToRgbaNeon, ConvertGrayAlphaToGrayNeon, ConvertRgbToGrayNeon, ConvertRgbaToGrayNeon, PremultiplyAlphaNeon };
+#endif
+
+    return { ConvertRgbToRgbaScalar, ConvertGrayToRgbaScalar, ConvertGrayAlphaToRgbaScalar, ConvertGrayAlphaToGrayScalar, ConvertRgbToGrayScalar, ConvertRgbaToGrayScalar, PremultiplyAlphaScalar };
+}
+
+static const PixelKernels& GetPixelKernels()
+{
+    static const PixelKernels kernels = SelectPixelKernels();
+    return kernels;
+}
+
+void ConvertRgbToRgba(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    GetPixelKernels().RgbToRgba(source, destination, pixelCount);
+}
+
+void ConvertGrayToRgba(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    GetPixelKernels().GrayToRgba(source, destination, pixelCount);
+}
+
+void ConvertGrayAlphaToRgba(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    GetPixelKernels().GrayAlphaToRgba(source, destination, pixelCount);
+}
+
+void ConvertGrayAlphaToGray(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    GetPixelKernels().GrayAlphaToGray(source, destination, pixelCount);
+}
+
+void ConvertRgbToGray(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    GetPixelKernels().RgbToGray(source, destination, pixelCount);
+}
+
+void ConvertRgbaToGray(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+    GetPixelKernels().RgbaToGray(source, destination, pixelCount);
+}
+
+void PremultiplyAlpha(uint8_t* pixels, size_t pixelCount)
+{
+    GetPixelKernels().PremultiplyAlpha(pixels, pixelCount);
+}
+
+// Stored in front of every block handed out by the image allocator hooks.
+struct ImageBlockHeader
+{
+    ImagePool* Pool;
+    uint64_t Capacity;
+};
+
+static_assert(sizeof(ImageBlockHeader) % 16 == 0, "Image blocks must stay 16 byte aligned for SIMD");
+
+static thread_local ImagePool* CurrentImagePool = nullptr;
+
+static uint32_t GetImageSizeClass(size_t size)
+{
+    uint32_t sizeClass = 0;
+
+    while (sizeClass < ImagePool::SizeClassCount && ((size_t) 1 << (sizeClass + ImagePool::MinBlockShift)) < size)
+    {
+        sizeClass++;
+    }
+
+    return sizeClass;
+}
+
+static void* AllocateImageBlock(ImagePool* pool, size_t capacity)
+{
+    ImageBlockHeader* header = (ImageBlockHeader*) SDL_malloc(sizeof(ImageBlockHeader) + capacity);
+
+    if (header == NULL)
+    {
+        return nullptr;
+    }
+
+    header->Pool = pool;
+    header->Capacity = capacity;
+
+    return header + 1;
+}
+
+void* AllocateImageMemory(size_t size)
+{
+    if (CurrentImagePool != nullptr)
+    {
+        return CurrentImagePool->Allocate(size);
+    }
+
+    return AllocateImageBlock(nullptr, size);
+}
+
+void* ReallocateImageMemory(void* data, size_t size)
+{
+    if (data == NULL)
+    {
+        return AllocateImageMemory(size);
+    }
+
+    ImageBlockHeader* header = (ImageBlockHeader*) data - 1;
+
+    // Pooled blocks usually have room to grow into already.
+    if (size <= header->Capacity)
+    {
+        return data;
+    }
+
+    void* grown = AllocateImageMemory(size);
+
+    if (grown == NULL)
+    {
+        return nullptr;
+    }
+
+    SDL_memcpy(grown, data, header->Capacity);
+    FreeImageMemory(data);
+
+    return grown;
+}
+
+void FreeImageMemory(void* data)
+{
+    if (data == NULL)
+    {
+        return;
+    }
+
+    ImageBlockHeader* header = (ImageBlockHeader*) data - 1;
+
+    if (header->Pool != nullptr)
+    {
+        header->Pool->Free(data);
+        return;
+    }
+
+    SDL_free(header);
+}
+
+ImagePool::ImagePool()
+    : _mutex(SDL_CreateMutex())
+{ }
+
+void* ImagePool::Allocate(size_t size)
+{
+    uint32_t sizeClass = GetImageSizeClass(size);
+
+    // Blocks above the largest size class are too rare to be worth keeping around.
+    if (sizeClass == SizeClassCount)
+    {
+        return AllocateImageBlock(nullptr, size);
+    }
+
+    SDL_LockMutex(_mutex);
+
+    void* data = _freeBlocks[sizeClass];
+
+    // Free blocks link to the next one through their first bytes.
+    if (data != NULL)
+    {
+        _freeBlocks[sizeClass] = *(void**) data;
+    }
+
+    SDL_UnlockMutex(_mutex);
+
+    if (data != NULL)
+    {
+        return data;
+    }
+
+    return AllocateImageBlock(this, (size_t) 1 << (sizeClass + MinBlockShift));
+}
+
+void ImagePool::Free(void* data)
+{
+    ImageBlockHeader* header = (ImageBlockHeader*) data - 1;
+    uint32_t sizeClass = GetImageSizeClass(header->Capacity);
+
+    SDL_LockMutex(_mutex);
+
+    *(void**) data = _freeBlocks[sizeClass];
+    _freeBlocks[sizeClass] = data;
+
+    SDL_UnlockMutex(_mutex);
+}
+
+void ImagePool::Trim()
+{
+    void* freeBlocks[SizeClassCount];
+
+    SDL_LockMutex(_mutex);
+
+    for (uint32_t sizeClass = 0; sizeClass < SizeClassCount; sizeClass++)
+    {
+        freeBlocks[sizeClass] = _freeBlocks[sizeClass];
+        _freeBlocks[sizeClass] = NULL;
+    }
+
+    SDL_UnlockMutex(_mutex);
+
+    for (void* data : freeBlocks)
+    {
+        while (data != NULL)
+        {
+            void* next = *(void**) data;
+            SDL_free((ImageBlockHeader*) data - 1);
+            data = next;
+        }
+    }
+}
+
+void ImagePool::Release()
+{
+    Trim();
+
+    SDL_DestroyMutex(_mutex);
+    _mutex = NULL;
+}
+
+Image::Image(void* data, uint32_t width, uint32_t height, uint32_t channels)
+    : Data(data), Width(width), Height(height), Channels(channels)
+{
+
+}
+
+Image::Image(Image&& other) noexcept
+    : Data(other.Data), Width(other.Width), Height(other.Height), Channels(other.Channels)
+{
+    other.Data = nullptr;
+}
+
+Image& Image::operator=(Image&& other) noexcept
+{
+    if (this != &other)
+    {
+        FreeImageMemory(Data);
+
+        Data = other.Data;
+        Width = other.Width;
+        Height = other.Height;
+        Channels = other.Channels;
+
+        other.Data = nullptr;
+    }
+
+    return *this;
+}
+
+Image::~Image()
+{
+    FreeImageMemory(Data);
+}
+
+// Turns decoded pixels into targetChannels per pixel, freeing the decoded ones if it had to copy.
+static uint8_t* ConvertImageChannels(uint8_t* pixels, size_t pixelCount, uint32_t channels, uint32_t targetChannels)
+{
+    if (channels == targetChannels)
+    {
+        return pixels;
+    }
+
+    uint8_t* converted = (uint8_t*) AllocateImageMemory(pixelCount * targetChannels);
+
+    if (converted == NULL)
+    {
+        stbi_image_free(pixels);
+        return nullptr;
+    }
+
+    if (targetChannels == 1 && channels == 2)
+    {
+        ConvertGrayAlphaToGray(pixels, converted, pixelCount);
+    }
+    else if (targetChannels == 1 && channels == 3)
+    {
+        ConvertRgbToGray(pixels, converted, pixelCount);
+    }
+    else if (targetChannels == 1)
+    {
+        ConvertRgbaToGray(pixels, converted, pixelCount);
+    }
+    else if (channels == 1)
+    {
+        ConvertGrayToRgba(pixels, converted, pixelCount);
+    }
+    else if (channels == 2)
+    {
+        ConvertGrayAlphaToRgba(pixels, converted, pixelCount);
+    }
+    else
+    {
+        ConvertRgbToRgba(pixels, converted, pixelCount);
+    }
+
+    stbi_image_free(pixels);
+
+    return converted;
+}
+
+static std::optional<Image> DecodeImage(const std::string& filePath, SDL_GPUTextureFormat format, bool premultiplyAlpha)
+{
+    if (format != SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM && format != SDL_GPU_TEXTUREFORMAT_R8_UNORM)
+    {
+        SDL_Log("Can not load image %s as texture format %u", filePath.c_str(), (uint32_t) format);
+        return std::nullopt;
+    }
+
+    uint32_t targetChannels = SDL_GPUTextureFormatTexelBlockSize(format);
+
+    // The per-thread flag keeps LoadImage safe to call from several threads at once.
+    stbi_set_flip_vertically_on_load_thread(true);
+
+    std::optional<AssetFile> imageFile = AssetFile::Open(filePath);
+
+    if (imageFile == std::nullopt)
+    {
+        return std::nullopt;
+    }
+
+    std::span<const uint8_t> imageData = imageFile->GetData();
+
+    // Decoded with the channels of the file, the kernels above convert to the target layout.
     int32_t width, height, channels;
-    void* data = stbi_load(filePath.c_str(), &width, &height, &channels, 0);
+    uint8_t* data = stbi_load_from_memory(imageData.data(), (int) imageData.size(), &width, &height, &channels, 0);
+
+    imageFile->Release();
+
+    if (data == NULL)
+    {
+        SDL_Log("Failed to load image %s: %s", filePath.c_str(), stbi_failure_reason());
+        return std::nullopt;
+    }
+
+    bool hasAlpha = channels == 2 || channels == 4;
+    size_t pixelCount = (size_t) width * height;
+
+    data = ConvertImageChannels(data, pixelCount, channels, targetChannels);
+
+    if (data == NULL)
+    {
+        SDL_Log("Failed to allocate converted pixels of image %s", filePath.c_str());
+        return std::nullopt;
+    }
+
+    if (premultiplyAlpha && hasAlpha && targetChannels == 4)
+    {
+        PremultiplyAlpha(data, pixelCount);
+    }
+
+    return Image(data, width, height, targetChannels);
+}
+
+std::optional<Image> ImageLoader::Load(const std::string& filePath, SDL_GPUTextureFormat format, bool premultiplyAlpha)
+{
+    ImagePool* previousPool = CurrentImagePool;
+    CurrentImagePool = &_pool;
+
+    std::optional<Image> image = DecodeImage(filePath, format, premultiplyAlpha);
+
+    CurrentImagePool = previousPool;
+
+    return image;
+}
+
+std::vector<std::optional<Image>> ImageLoader::LoadMany(const std::vector<std::string>& filePaths, SDL_GPUTextureFormat format, bool premultiplyAlpha, uint32_t threadCount)
+{
+    std::vector<std::optional<Image>> images(filePaths.size());
+
+    ParallelFor(filePaths.size(), [&](size_t i)
+    {
+        images[i] = Load(filePaths[i], format, premultiplyAlpha);
+    }, threadCount);
 
-    return new Image(data, width, height, channels);
+    return images;
+}
+
+struct LoadImagesContext
+{
+    ImageLoader* Loader;
+    std::vector<std::string> FilePaths;
+    SDL_GPUTextureFormat Format;
+    bool PremultiplyAlpha;
+    std::vector<std::promise<std::optional<Image>>> Promises;
+    uint32_t ThreadCount;
+};
+
+static int RunLoadImages(void* data)
+{
+    LoadImagesContext* context = (LoadImagesContext*) data;
+
+    ParallelFor(context->FilePaths.size(), [context](size_t i)
+    {
+        context->Promises[i].set_value(context->Loader->Load(context->FilePaths[i], context->Format, context->PremultiplyAlpha));
+    }, context->ThreadCount);
+
+    delete context;
+
+    return 0;
+}
+
+std::vector<std::future<std::optional<Image>>> ImageLoader::LoadManyAsync(const std::vector<std::string>& filePaths, SDL_GPUTextureFormat format, bool premultiplyAlpha, uint32_t threadCount)
+{
+    LoadImagesContext* context = new LoadImagesContext{ .Loader = this, .FilePaths = filePaths, .Format = format, .PremultiplyAlpha = premultiplyAlpha, .Promises = std::vector<std::promise<std::optional<Image>>>(filePaths.size()), .ThreadCount = threadCount };
+    std::vector<std::future<std::optional<Image>>> futures;
+
+    for (std::promise<std::optional<Image>>& promise : context->Promises)
+    {
+        futures.push_back(promise.get_future());
+    }
+
+    SDL_Thread* thread = SDL_CreateThread(RunLoadImages, "LoadImages", context);
+
+    if (thread == NULL)
+    {
+        SDL_Log("Failed to create image loading thread, loading on the calling thread: %s", SDL_GetError());
+        RunLoadImages(context);
+        return futures;
+    }
+
+    _threads.push_back(thread);
+
+    return futures;
+}
+
+void ImageLoader::Trim()
+{
+    _pool.Trim();
+}
+
+void ImageLoader::Release()
+{
+    // Background loads still decode into the pool, so they have to finish first.
+    for (SDL_Thread* thread : _threads)
+    {
+        SDL_WaitThread(thread, NULL);
+    }
+
+    _threads.clear();
+    _pool.Release();
+}
+
+std::optional<Image> LoadImage(const std::string& filePath, SDL_GPUTextureFormat format, bool premultiplyAlpha)
+{
+    return DecodeImage(filePath, format, premultiplyAlpha);
 }
 
 void TickTime(Time& time)
@@ -5,6 +5,15 @@
 #include <optional>
 #include <vector>
 #include <memory>
+#include <deque>
+#include <unordered_set>
+#include <unordered_map>
+#include <map>
+#include <tuple>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <span>
 
 #include <SDL3/SDL.h>
 
@@ -29,35 +38,169 @@ struct ShaderCreateInfo
     uint32_t NumUniformBuffers = 0;
 };
 
+// Read-only view of a whole file mapped into memory, so its contents can be used in place
+// without copying them into a heap buffer first. The span stays valid until Release.
+class AssetFile
+{
+public:
+    static std::optional<AssetFile> Open(const std::string& filePath);
+
+    std::span<const uint8_t> GetData() const;
+
+    void Release();
+
+private:
+    const uint8_t* Data;
+    size_t Size;
+
+#ifdef _WIN32
+    void* FileHandle;
+    void* MappingHandle;
+
+    AssetFile(const uint8_t* data, size_t size, void* fileHandle, void* mappingHandle);
+#else
+    AssetFile(const uint8_t* data, size_t size);
+#endif
+};
+
+// Features of the permutation shaders in Common/shaders. The bits match SHADER_FEATURES
+// in CMakeLists.txt, which compiles one variant per listed feature combination.
+namespace ShaderFeature
+{
+    constexpr uint32_t VertexColor = 1 << 0;
+    constexpr uint32_t Transform = 1 << 1;
+    constexpr uint32_t ModelViewProjection = 1 << 2;
+    constexpr uint32_t TextureMix = 1 << 3;
+}
+
+struct ShaderVariant
+{
+    uint32_t Features;
+    const uint8_t* Code;
+    size_t CodeSize;
+};
+
+// Picks the variant compiled for exactly these features. Asking for a combination that
+// was not compiled fails the build.
+template <size_t Count>
+consteval ShaderVariant SelectShaderVariant(const ShaderVariant (&variants)[Count], uint32_t features)
+{
+    for (const ShaderVariant& variant : variants)
+    {
+        if (variant.Features == features)
+        {
+            return variant;
+        }
+    }
+
+    throw "Shader variant was not compiled, add it to CMakeLists.txt";
+}
+
 class Shader
 {
 public:
     static std::optional<Shader> FromSPV(SDL_GPUDevice* graphicsDevice, const std::string& shaderPath, const ShaderCreateInfo& shaderCreateInfo);
+    static std::optional<Shader> FromMemory(SDL_GPUDevice* graphicsDevice, const void* code, size_t codeSize, const ShaderCreateInfo& shaderCreateInfo);
+    static std::optional<Shader> FromVariant(SDL_GPUDevice* graphicsDevice, const ShaderVariant& variant, const ShaderCreateInfo& shaderCreateInfo);
 
     SDL_GPUShader* GetHandle() const;
 
+    // Identify the module by its contents, which outlive the handle address once released.
+    uint64_t GetCodeHash() const;
+    size_t GetCodeSize() const;
+    const ShaderCreateInfo& GetCreateInfo() const;
+
     void Release();
 
 private:
     SDL_GPUDevice* GraphicsDeviceHandle;
     SDL_GPUShader* ShaderHandle;
+    uint64_t CodeHash;
+    size_t CodeSize;
+    ShaderCreateInfo CreateInfo;
+
+    Shader(SDL_GPUDevice* graphicsDeviceHandle, SDL_GPUShader* shaderHandle, uint64_t codeHash, size_t codeSize, const ShaderCreateInfo& createInfo);
+};
+
+// Interns shaders so that pipelines sharing a module load and create it once. Shaders are
+// keyed by their path, or by a hash and size of their code, together with the
+// ShaderCreateInfo. In-memory code is also kept as a copy and compared on a hit, so colliding
+// hashes never share a shader. Shaders are released once every acquire has been matched by
+// a release.
+class ShaderCache
+{
+public:
+    ShaderCache(SDL_GPUDevice* graphicsDevice);
+
+    Shader* Acquire(const std::string& shaderPath, const ShaderCreateInfo& shaderCreateInfo);
+    Shader* Acquire(const void* code, size_t codeSize, const ShaderCreateInfo& shaderCreateInfo);
+
+    void Release(Shader* shader);
+
+    // Releases every cached shader regardless of outstanding references.
+    void Release();
+
+private:
+    // Path, code hash, code size, stage, samplers, storage textures, storage buffers, uniform buffers.
+    typedef std::tuple<std::string, uint64_t, uint64_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t> CacheKey;
+
+    struct CacheEntry
+    {
+        Shader CachedShader;
+        uint32_t ReferenceCount;
+
+        // Empty for shaders loaded from a path.
+        std::vector<uint8_t> Code;
+    };
+
+    typedef std::multimap<CacheKey, CacheEntry> CacheEntries;
+
+    static CacheKey MakeKey(const std::string& shaderPath, uint64_t codeHash, size_t codeSize, const ShaderCreateInfo& shaderCreateInfo);
+    Shader* Find(const CacheKey& key, const void* code, size_t codeSize);
+    Shader* Insert(const CacheKey& key, std::optional<Shader> shader, const void* code, size_t codeSize);
+
+    SDL_GPUDevice* _graphicsDevice;
 
-    Shader(SDL_GPUDevice* graphicsDeviceHandle, SDL_GPUShader* shaderHandle);
+    CacheEntries _entries;
+    std::map<const Shader*, CacheEntries::iterator> _keys;
 };
 
 struct VertexBufferDescription
 {
     uint32_t Slot;
     uint32_t Pitch;
+
+    // Per-instance streams advance once every InstanceStepRate instances, zero meaning one.
+    SDL_GPUVertexInputRate InputRate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+    uint32_t InstanceStepRate = 0;
+};
+
+enum class BlendMode
+{
+    Opaque,
+    AlphaBlend,
+    PremultipliedAlpha,
+    Additive,
 };
 
 struct PipelineCreateInfo
 {
     Shader* VertexShader;
     Shader* FragmentShader;
-    VertexBufferDescription VertexBufferDescription;
+    std::vector<VertexBufferDescription> VertexBufferDescriptions;
     std::vector<SDL_GPUVertexAttribute> VertexAttributes;
     std::optional<SDL_GPUTextureFormat> DepthStencilFormat;
+
+    BlendMode Blend = BlendMode::AlphaBlend;
+    SDL_GPUCullMode CullMode = SDL_GPU_CULLMODE_NONE;
+    SDL_GPUFrontFace FrontFace = SDL_GPU_FRONTFACE_COUNTER_CLOCKWISE;
+
+    // Only used with a DepthStencilFormat.
+    SDL_GPUCompareOp DepthCompare = SDL_GPU_COMPAREOP_LESS;
+    bool DepthWrite = true;
+
+    // Depth-only pipelines have no colour target and are used in render passes without one.
+    bool DepthOnly = false;
 };
 
 class Pipeline
@@ -76,48 +219,708 @@ private:
     Pipeline(SDL_GPUDevice* graphicsDevice, SDL_GPUGraphicsPipeline* pipelineHandle);
 };
 
+// Draws opaque geometry in two passes to avoid shading hidden fragments. The first pass
+// only writes depth, the second shades each pixel once by testing for equal depth with
+// depth writes off. Both pipelines are created from the same create info, which needs a
+// DepthStencilFormat.
+class DepthPrepassPipeline
+{
+public:
+    static std::optional<DepthPrepassPipeline> Create(SDL_GPUDevice* graphicsDevice, SDL_Window* window, const PipelineCreateInfo& createInfo);
+
+    // Records both passes, calling draw once in each after binding the pass's pipeline.
+    // The depth target is cleared or loaded as given by the first pass and kept for the second.
+    void Render(SDL_GPUCommandBuffer* commandBuffer, const SDL_GPUColorTargetInfo& colorTargetInfo, const SDL_GPUDepthStencilTargetInfo& depthTargetInfo, const std::function<void(SDL_GPURenderPass*)>& draw) const;
+
+    SDL_GPUGraphicsPipeline* GetDepthHandle() const;
+    SDL_GPUGraphicsPipeline* GetColorHandle() const;
+
+    void Release();
+
+private:
+    Pipeline DepthPipeline;
+    Pipeline ColorPipeline;
+
+    DepthPrepassPipeline(const Pipeline& depthPipeline, const Pipeline& colorPipeline);
+};
+
+struct PipelineBatchEntry
+{
+    // Each shader is loaded from its SPIR-V path, or created from its code when that is set,
+    // such as the Code and CodeSize of a ShaderVariant. The code must outlive Compile.
+    std::string VertexShaderPath;
+    const void* VertexShaderCode = nullptr;
+    size_t VertexShaderCodeSize = 0;
+    ShaderCreateInfo VertexShaderInfo;
+
+    std::string FragmentShaderPath;
+    const void* FragmentShaderCode = nullptr;
+    size_t FragmentShaderCodeSize = 0;
+    ShaderCreateInfo FragmentShaderInfo;
+
+    // VertexShader and FragmentShader are filled in from the shaders compiled above.
+    PipelineCreateInfo PipelineInfo;
+};
+
+struct PipelineBatchResult
+{
+    std::optional<Pipeline> CompiledPipeline;
+    uint64_t ShaderCompileNanoseconds = 0;
+    uint64_t PipelineCompileNanoseconds = 0;
+};
+
+// Compiles a list of pipelines concurrently. Each unique shader is compiled once, then
+// every pipeline is created, both spread over worker threads. Compile blocks until all
+// of them are done, so it belongs before the first frame.
+class PipelineBatch
+{
+public:
+    // A threadCount of zero uses one thread per logical CPU core.
+    bool Compile(SDL_GPUDevice* graphicsDevice, SDL_Window* window, const std::vector<PipelineBatchEntry>& entries, uint32_t threadCount = 0);
+
+    // Results are in the order of the entries passed to Compile.
+    const std::vector<PipelineBatchResult>& GetResults() const;
+    Pipeline* GetPipeline(size_t index);
+
+    void Release();
+
+private:
+    struct ShaderBuild
+    {
+        std::string Path;
+        const void* Code;
+        size_t CodeSize;
+        ShaderCreateInfo Info;
+        std::optional<Shader> CompiledShader;
+        uint64_t CompileNanoseconds = 0;
+    };
+
+    std::vector<ShaderBuild> _shaders;
+    std::vector<PipelineBatchResult> _results;
+};
+
+// Shares pipelines between identical create infos. The key covers every field of the
+// PipelineCreateInfo, including each vertex attribute and the code and create info of both
+// shaders rather than their handles, and the window's swapchain format,
+// so only unique states reach the driver. Pipelines are released once every acquire has
+// been matched by a release.
+class PipelineCache
+{
+public:
+    PipelineCache(SDL_GPUDevice* graphicsDevice, SDL_Window* window);
+
+    Pipeline* Acquire(const PipelineCreateInfo& createInfo);
+
+    void Release(Pipeline* pipeline);
+
+    // Releases every cached pipeline regardless of outstanding references.
+    void Release();
+
+    size_t GetPipelineCount() const;
+
+private:
+    typedef std::vector<uint64_t> CacheKey;
+
+    struct CacheKeyHash
+    {
+        size_t operator()(const CacheKey& key) const;
+    };
+
+    struct CacheEntry
+    {
+        Pipeline CachedPipeline;
+        uint32_t ReferenceCount;
+    };
+
+    CacheKey MakeKey(const PipelineCreateInfo& createInfo) const;
+
+    SDL_GPUDevice* _graphicsDevice;
+    SDL_Window* _window;
+
+    std::unordered_map<CacheKey, CacheEntry, CacheKeyHash> _entries;
+    std::unordered_map<const Pipeline*, CacheKey> _keys;
+};
+
+struct HotShaderSource
+{
+    std::string SourcePath;
+    std::string OutputPath;
+    ShaderCreateInfo Info;
+};
+
+// Watches GLSL sources of pipelines, recompiles them with glslc when they change and
+// rebuilds the affected pipelines on a background thread. Uses inotify on Linux and polls
+// modification times elsewhere. Rebuilt pipelines are only installed by SwapPipelines,
+// which belongs between frames. The pipelines passed to AddPipeline stay owned by the caller.
+// Relative output paths are resolved against the directory of the executable.
+class ShaderHotReloader
+{
+public:
+    ShaderHotReloader(SDL_GPUDevice* graphicsDevice, SDL_Window* window);
+
+    // Pipelines are added before Start. The shaders in createInfo are replaced on rebuild.
+    size_t AddPipeline(const Pipeline& pipeline, const HotShaderSource& vertexShader, const HotShaderSource& fragmentShader, const PipelineCreateInfo& createInfo);
+
+    bool Start();
+
+    // Installs the pipelines rebuilt since the last call.
+    void SwapPipelines();
+
+    SDL_GPUGraphicsPipeline* GetHandle(size_t index) const;
+
+    void Release();
+
+private:
+    struct HotPipeline
+    {
+        SDL_GPUGraphicsPipeline* Original;
+        std::optional<Pipeline> Current;
+        std::optional<Pipeline> Rebuilt;
+
+        HotShaderSource VertexShader;
+        HotShaderSource FragmentShader;
+        PipelineCreateInfo CreateInfo;
+    };
+
+    static int Run(void* data);
+    void WatchSources();
+    std::vector<std::string> WaitForChanges();
+    void PollSource(std::pair<std::string, SDL_Time>& source, std::vector<std::string>& changedSources);
+    bool CompileShader(const HotShaderSource& shader);
+    void RebuildPipelines(const std::vector<size_t>& pipelineIndices);
+
+    SDL_GPUDevice* _graphicsDevice;
+    SDL_Window* _window;
+
+    std::deque<HotPipeline> _pipelines;
+    std::vector<std::pair<std::string, SDL_Time>> _sources;
+
+    // Every pipeline using a source, as vertex or fragment shader.
+    std::unordered_map<std::string, std::vector<size_t>> _pipelinesBySource;
+
+    SDL_Mutex* _mutex = NULL;
+    SDL_Thread* _thread = NULL;
+    std::atomic<bool> _isRunning = false;
+
+#ifdef __linux__
+    int _inotify = -1;
+    std::unordered_map<int, std::string> _watchedDirectories;
+    std::vector<std::string> _polledSources;
+#endif
+};
+
+struct UploadTicket
+{
+    uint64_t Id;
+};
+
+// Persistent upload staging memory. Allocations are carved out of one transfer buffer
+// and handed back once the fence of the command buffer that consumed them signals.
+// The buffer only grows when an allocation does not fit into it. Allocated memory
+// stays mapped and writable until Unmap() is called before recording the copy pass.
+class TransferRing
+{
+public:
+    struct Allocation
+    {
+        SDL_GPUTransferBuffer* TransferBuffer;
+        uint32_t Offset;
+        uint8_t* Data;
+    };
+
+    TransferRing(SDL_GPUDevice* graphicsDevice, uint32_t capacity);
+
+    std::optional<Allocation> Allocate(uint32_t size);
+    void Unmap();
+    UploadTicket Retire(SDL_GPUFence* fence);
+    void Reclaim();
+    bool IsComplete(UploadTicket ticket);
+    bool Wait(UploadTicket ticket);
+    void Release();
+
+    uint32_t GetCapacity() const;
+
+private:
+    struct InFlightRegion
+    {
+        SDL_GPUFence* Fence;
+        uint32_t Size;
+        uint64_t Ticket;
+    };
+
+    bool Grow(uint32_t size);
+    bool WaitForOldestRegion();
+
+    SDL_GPUDevice* _graphicsDevice;
+    SDL_GPUTransferBuffer* _transferBuffer = nullptr;
+    uint8_t* _mappedData = nullptr;
+
+    uint32_t _capacity;
+    uint32_t _head = 0;
+    uint32_t _used = 0;
+    uint32_t _pendingSize = 0;
+
+    uint64_t _nextTicket = 1;
+    uint64_t _completedTicket = 0;
+
+    std::vector<InFlightRegion> _inFlightRegions;
+    std::vector<SDL_GPUTransferBuffer*> _orphanedBuffers;
+    size_t _unmappedOrphanCount = 0;
+};
+
+// Destination of a texture upload. Depth is the number of slices of a 3D texture,
+// array layers and cube faces are selected with Layer.
+struct TextureUploadRegion
+{
+    SDL_GPUTexture* Texture;
+    SDL_GPUTextureFormat Format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    uint32_t MipLevel = 0;
+    uint32_t Layer = 0;
+    uint32_t X = 0;
+    uint32_t Y = 0;
+    uint32_t Z = 0;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Depth = 1;
+};
+
+static const uint32_t DefaultStagingSize = 8 * 1024 * 1024;
+static const uint32_t StagingAlignment = 16;
+
 class GPUUploader
 {
 public:
-    GPUUploader(SDL_GPUDevice* graphicsDevice);
+    GPUUploader(SDL_GPUDevice* graphicsDevice, uint32_t stagingSize = DefaultStagingSize);
+
+    // The Add functions return false when staging memory could not be reserved. Chunks
+    // staged before the failure stay pending, so adding the same data again is harmless.
+
+    bool AddVertexData(float vertices[], uint32_t size, SDL_GPUBuffer* vertexBuffer, uint32_t bufferOffset = 0);
+    bool AddIndexData(uint32_t indecies[], uint32_t size, SDL_GPUBuffer* indexBuffer, uint32_t bufferOffset = 0);
+    bool AddBufferData(const void* data, uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset = 0);
+    bool AddTextureData(void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM);
+
+    // Uploads a width x height region at x, y. Pixels point at the first texel of the region
+    // and consecutive rows are pixelsPerRow texels apart in the source image.
+    bool AddTextureRegion(void* pixels, uint32_t pixelsPerRow, uint32_t x, uint32_t y, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM);
+
+    // Uploads any mip level, array layer or 3D box of a texture. Zero pixelsPerRow and
+    // rowsPerLayer mean the source is packed tightly.
+    bool AddTextureSubresource(const void* pixels, const TextureUploadRegion& region, uint32_t pixelsPerRow = 0, uint32_t rowsPerLayer = 0);
+
+    // Uploads levelCount mips of one layer, stored tightly one after another starting with mip 0.
+    bool AddTextureMipChain(const void* pixels, uint32_t width, uint32_t height, uint32_t levelCount, SDL_GPUTexture* texture, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, uint32_t layer = 0);
+
+    // Fills every mip below mip 0 on the GPU after the copies of the same upload have run.
+    // The texture needs SDL_GPU_TEXTUREUSAGE_SAMPLER and SDL_GPU_TEXTUREUSAGE_COLOR_TARGET usage.
+    void GenerateMipmaps(SDL_GPUTexture* texture);
+
+    // Reserve staging memory for a copy and return a pointer to write the data into directly.
+    // The pointer stays valid until the next Upload. Texture rows are packed tightly.
+    // Reservations are never split, while the Add functions above break large data into
+    // chunks of half the staging size and submit each full chunk as they go, so reserved
+    // memory should be written before adding more data.
+    void* ReserveBufferData(uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset = 0);
+    void* ReserveTextureRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM);
+    void* ReserveTextureSubresource(const TextureUploadRegion& region);
 
-    void AddVertexData(float vertices[], uint32_t size, SDL_GPUBuffer* vertexBuffer, uint32_t bufferOffset = 0);
-    void AddIndexData(uint32_t indecies[], uint32_t size, SDL_GPUBuffer* indexBuffer, uint32_t bufferOffset = 0);
-    void AddTextureData(void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture);
     bool Upload();
 
+    // Submits the pending copies without waiting for them. The returned ticket can be
+    // polled or waited on to find out when the data is resident on the GPU.
+    std::optional<UploadTicket> UploadAsync();
+    bool IsResident(UploadTicket ticket);
+    bool Wait(UploadTicket ticket);
+
+    void Release();
+
 private:
-    struct VertexData
+    void FlushIfChunkFull(uint64_t size);
+    uint64_t GetChunkSize() const;
+
+    struct BufferCopy
     {
-        float* Vertices;
-        uint32_t Size;
-        SDL_GPUBuffer* VertexBuffer;
+        SDL_GPUTransferBuffer* TransferBuffer;
+        uint32_t TransferOffset;
+        SDL_GPUBuffer* Buffer;
         uint32_t BufferOffset;
+        uint32_t Size;
     };
 
-    struct IndexData
+    struct TextureCopy
+    {
+        SDL_GPUTransferBuffer* TransferBuffer;
+        uint32_t TransferOffset;
+        TextureUploadRegion Region;
+        uint32_t PixelsPerRow;
+        uint32_t RowsPerLayer;
+    };
+
+    std::vector<BufferCopy> BufferCopies;
+    std::vector<TextureCopy> TextureCopies;
+    std::vector<SDL_GPUTexture*> MipmapTextures;
+    uint64_t _pendingStagingSize = 0;
+
+    SDL_GPUDevice* _graphicsDevice;
+    TransferRing _transferRing;
+};
+
+enum class UploadPriority
+{
+    Critical,
+    High,
+    Normal,
+    Background,
+
+    Count
+};
+
+struct UploadRequestId
+{
+    uint64_t Id;
+};
+
+// Streams queued uploads through a GPUUploader a little at a time. Each Pump stages
+// requests in priority order until the byte or time budget for the frame runs out,
+// splitting large requests across frames. Critical requests ignore the budget.
+// Queued data must stay alive until the request is resident.
+class UploadQueue
+{
+public:
+    UploadQueue(GPUUploader* uploader);
+
+    UploadRequestId EnqueueBufferData(const void* data, uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset = 0, UploadPriority priority = UploadPriority::Normal);
+    UploadRequestId EnqueueTextureData(const void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, UploadPriority priority = UploadPriority::Normal);
+    UploadRequestId EnqueueTextureRegion(const void* pixels, uint32_t pixelsPerRow, uint32_t x, uint32_t y, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, UploadPriority priority = UploadPriority::Normal);
+    UploadRequestId EnqueueTextureSubresource(const void* pixels, const TextureUploadRegion& region, uint32_t pixelsPerRow = 0, UploadPriority priority = UploadPriority::Normal);
+
+    // Stages at most budgetBytes of queued data, or as much as fits into budgetMicroseconds
+    // of CPU time when that is not zero, and submits it.
+    std::optional<UploadTicket> Pump(uint64_t budgetBytes, uint64_t budgetMicroseconds = 0);
+
+    bool IsResident(UploadRequestId request);
+
+    // Drops whatever of the request is still queued. Parts that were staged already
+    // still reach the GPU, so the destination has to outlive the next submission.
+    void Cancel(UploadRequestId request);
+
+    bool IsEmpty() const;
+    uint64_t GetQueuedBytes() const;
+
+private:
+    struct UploadRequest
     {
-        uint32_t* Indecies;
+        uint64_t Id;
+        const uint8_t* Data;
+
+        SDL_GPUBuffer* Buffer;
+        uint32_t BufferOffset;
         uint32_t Size;
-        SDL_GPUBuffer* IndexBuffer;
+
+        std::optional<TextureUploadRegion> Texture;
+        uint32_t PixelsPerRow;
+
+        // Bytes staged so far for buffers, block rows of all slices for textures.
+        uint32_t Progress;
+    };
+
+    UploadRequestId Enqueue(const UploadRequest& request, UploadPriority priority);
+    // Returns the bytes staged, zero when staging memory ran out and nothing was advanced.
+    uint64_t StageRequest(UploadRequest& request, uint64_t budgetBytes, bool isCritical);
+    uint64_t GetRemainingBytes(const UploadRequest& request) const;
+
+    GPUUploader* _uploader;
+    std::deque<UploadRequest> _requests[(size_t) UploadPriority::Count];
+    std::unordered_set<uint64_t> _queuedRequests;
+    std::vector<uint64_t> _unsubmittedRequests;
+    std::vector<std::pair<uint64_t, UploadTicket>> _stagedRequests;
+    uint64_t _nextRequestId = 1;
+};
+
+// Fixed size lock-free queue for one producer thread and one consumer thread.
+template <typename T, size_t Capacity>
+class SingleProducerQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool Push(T&& item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail - _head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+
+        _items[tail & (Capacity - 1)] = std::move(item);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    std::optional<T> Pop()
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return std::nullopt;
+        }
+
+        T item = std::move(_items[head & (Capacity - 1)]);
+        _head.store(head + 1, std::memory_order_release);
+
+        return item;
+    }
+
+private:
+    T _items[Capacity];
+    alignas(64) std::atomic<size_t> _head = 0;
+    alignas(64) std::atomic<size_t> _tail = 0;
+};
+
+// Runs uploads on a thread of its own so the copies are recorded and submitted while the
+// render thread records the frame. The worker owns a GPUUploader with its own transfer
+// buffers, command buffers and fences. Jobs are submitted from one thread only, and their
+// data must stay alive until the job is resident.
+class UploadWorker
+{
+public:
+    static const size_t QueueCapacity = 256;
+
+    UploadWorker(SDL_GPUDevice* graphicsDevice, uint32_t stagingSize = DefaultStagingSize);
+
+    bool Start();
+
+    // Return std::nullopt when the job queue is full.
+    std::optional<UploadRequestId> SubmitBufferData(const void* data, uint32_t size, SDL_GPUBuffer* buffer, uint32_t bufferOffset = 0);
+    std::optional<UploadRequestId> SubmitTextureData(const void* pixels, uint32_t width, uint32_t height, SDL_GPUTexture* texture, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, bool generateMipmaps = false);
+    std::optional<UploadRequestId> SubmitTextureSubresource(const void* pixels, const TextureUploadRegion& region, uint32_t pixelsPerRow = 0);
+
+    // Jobs become resident in the order they were submitted.
+    bool IsResident(UploadRequestId request) const;
+
+    // Returns the next job that became resident since the last call, if any.
+    std::optional<UploadRequestId> PollResident();
+
+    // Stops the thread after it has submitted the queued jobs and releases its resources.
+    void Release();
+
+private:
+    struct UploadJob
+    {
+        uint64_t Id;
+        const void* Data;
+
+        SDL_GPUBuffer* Buffer;
         uint32_t BufferOffset;
+        uint32_t Size;
+
+        std::optional<TextureUploadRegion> Texture;
+        uint32_t PixelsPerRow;
+        bool GenerateMipmaps;
     };
 
-    struct TextureData
+    std::optional<UploadRequestId> Submit(UploadJob&& job);
+    static int Run(void* data);
+    void ProcessJobs();
+
+    GPUUploader _uploader;
+    SDL_Thread* _thread = NULL;
+    SDL_Semaphore* _wakeSemaphore = NULL;
+    std::atomic<bool> _isRunning = false;
+
+    SingleProducerQueue<UploadJob, QueueCapacity> _jobs;
+    SingleProducerQueue<uint64_t, QueueCapacity> _residentJobs;
+    std::atomic<uint64_t> _residentId = 0;
+    uint64_t _nextRequestId = 1;
+};
+
+// Shares GPU buffers and textures between identical uploads. Payloads are looked up by a
+// 64-bit hash of their bytes together with their size, format and usage, and a copy of the
+// bytes is kept to compare against on a hit, so colliding hashes never share a resource.
+// Resources stay alive until every acquire has been matched by a release.
+class UploadCache
+{
+public:
+    UploadCache(SDL_GPUDevice* graphicsDevice, GPUUploader* uploader);
+
+    SDL_GPUBuffer* AcquireBuffer(const void* data, uint32_t size, SDL_GPUBufferUsageFlags usage);
+    SDL_GPUTexture* AcquireTexture(const void* pixels, uint32_t width, uint32_t height, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, bool generateMipmaps = false);
+
+    void ReleaseBuffer(SDL_GPUBuffer* buffer);
+    void ReleaseTexture(SDL_GPUTexture* texture);
+
+    // Releases every cached resource regardless of outstanding references.
+    void Release();
+
+private:
+    // Content hash, size in bytes, usage or format, width, height, mip level count.
+    typedef std::tuple<uint64_t, uint64_t, uint32_t, uint32_t, uint32_t, uint32_t> CacheKey;
+
+    struct CacheEntry
+    {
+        void* Resource;
+        bool IsTexture;
+        uint32_t ReferenceCount;
+        std::vector<uint8_t> Contents;
+    };
+
+    typedef std::multimap<CacheKey, CacheEntry> CacheEntries;
+
+    void* Find(const CacheKey& key, const void* data);
+    void Insert(const CacheKey& key, void* resource, bool isTexture, const void* data);
+    void ReleaseResource(void* resource);
+
+    SDL_GPUDevice* _graphicsDevice;
+    GPUUploader* _uploader;
+
+    CacheEntries _entries;
+    std::map<void*, CacheEntries::iterator> _resources;
+};
+
+// Calls body for every index below count from up to threadCount threads, the calling
+// thread included, and returns once all calls have finished. A threadCount of zero uses
+// one thread per logical CPU core.
+void ParallelFor(size_t count, const std::function<void(size_t)>& body, uint32_t threadCount = 0);
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Width and height in texels of one block of the format, 4 for block-compressed formats and 1 otherwise.
+uint32_t GetTextureFormatBlockExtent(SDL_GPUTextureFormat format);
+uint64_t GetTextureSubresourceSize(SDL_GPUTextureFormat format, uint32_t width, uint32_t height, uint32_t depth = 1);
+// Size of levelCount mips stored tightly one after another, starting with mip 0.
+uint64_t GetMipChainSize(SDL_GPUTextureFormat format, uint32_t width, uint32_t height, uint32_t levelCount);
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+// Header of a texture baked offline by TextureBaker. It is followed by DataSize bytes
+// holding LevelCount mips from mip 0 down, stored tightly in Format with the rows already
+// flipped the way LoadImage flips them. Block-compressed mips are padded to whole blocks.
+struct BakedTextureHeader
+{
+    static const uint32_t ExpectedMagic = 0x5854534C; // "LSTX"
+    static const uint32_t CurrentVersion = 1;
+
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Format;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t LevelCount;
+    uint64_t DataSize;
+};
+
+// TextureBaker writes an RGBA8 copy of every block-compressed texture next to it, for GPUs
+// that can't sample the compressed format. "name.tex" falls back to "name.rgba8.tex".
+std::string GetBakedTextureFallbackPath(const std::string& filePath);
+
+// Maps a baked texture, creates a sampled texture with all of its mips and copies the
+// mapped mips straight into the uploader's staging memory. Uses the RGBA8 copy when the
+// GPU can't sample the baked format.
+SDL_GPUTexture* LoadBakedTexture(SDL_GPUDevice* graphicsDevice, GPUUploader& uploader, const std::string& filePath);
+
+// Baked texture that can be sampled from the first frame and refines from its smallest mip
+// up. Mips no larger than initialSize are staged on the uploader right away, the others are
+// queued coarse to fine and land as the queue is pumped within its per-frame budget. The
+// file stays mapped until every mip is resident or the texture is released, which cancels
+// the mips still queued. Falls back to the RGBA8 copy like LoadBakedTexture.
+class StreamingTexture
+{
+public:
+    StreamingTexture(StreamingTexture&& other) noexcept;
+    StreamingTexture& operator=(StreamingTexture&& other) noexcept;
+    StreamingTexture(const StreamingTexture&) = delete;
+    StreamingTexture& operator=(const StreamingTexture&) = delete;
+
+    static std::optional<StreamingTexture> Open(SDL_GPUDevice* graphicsDevice, GPUUploader& uploader, UploadQueue& uploadQueue, const std::string& filePath, const SDL_GPUSamplerCreateInfo& samplerInfo, uint32_t initialSize = 16, UploadPriority priority = UploadPriority::Normal);
+
+    // Picks up the mips that became resident, called once per frame after pumping the queue.
+    void Update();
+
+    bool IsComplete() const;
+
+    // Finest mip that can be sampled, zero once the texture is complete.
+    uint32_t GetResidentMipLevel() const;
+
+    SDL_GPUTexture* GetHandle() const;
+
+    // Sampler created from the given info that keeps to the resident mips. It is replaced
+    // whenever finer mips become resident.
+    SDL_GPUSampler* GetSampler() const;
+
+    void Release();
+
+private:
+    struct PendingMip
     {
-        void* Pixels;
-        uint32_t Width;
-        uint32_t Height;
-        SDL_GPUTexture* Texture;
+        uint32_t MipLevel;
+        UploadRequestId Request;
     };
 
-    std::vector<VertexData> Vertices;
-    std::vector<IndexData> Indecies;
-    std::vector<TextureData> Textures;
+    StreamingTexture(SDL_GPUDevice* graphicsDevice, UploadQueue* uploadQueue, const AssetFile& textureFile, SDL_GPUTexture* texture, const SDL_GPUSamplerCreateInfo& samplerInfo);
+
+    bool CreateSampler();
 
     SDL_GPUDevice* _graphicsDevice;
+    UploadQueue* _uploadQueue;
+    AssetFile _textureFile;
+    SDL_GPUTexture* _texture;
+    SDL_GPUSamplerCreateInfo _samplerInfo;
+    SDL_GPUSampler* _sampler = NULL;
+    uint32_t _residentMipLevel = 0;
+    uint32_t _samplerMipLevel = 0;
+    bool _isFileMapped = true;
+    std::deque<PendingMip> _pendingMips;
 };
 
+// Pixel layout conversions, run with AVX2, SSE4.1 or NEON where the CPU has them.
+// Source and destination must not overlap.
+void ConvertRgbToRgba(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+void ConvertGrayToRgba(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+void ConvertGrayAlphaToRgba(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+void ConvertGrayAlphaToGray(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+// Luminance with stb_image's weights of 77, 150 and 29 out of 256.
+void ConvertRgbToGray(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+void ConvertRgbaToGray(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+void PremultiplyAlpha(uint8_t* pixels, size_t pixelCount);
+
+// Allocator hooks stb_image is compiled with. Memory comes from the pool of the ImageLoader
+// loading on the calling thread, or straight from the heap outside of a load.
+void* AllocateImageMemory(size_t size);
+void* ReallocateImageMemory(void* data, size_t size);
+void FreeImageMemory(void* data);
+
+// Reusable memory for decoded pixels and stb_image's scratch buffers. Blocks are rounded up
+// to a power of two and kept on a free list per size class once freed, so loading images of
+// similar sizes again does not go back to the heap. Images still holding pooled memory must
+// be destroyed before the pool is released.
+class ImagePool
+{
+public:
+    static const uint32_t MinBlockShift = 8;
+    static const uint32_t SizeClassCount = 21;
+
+    ImagePool();
+    ImagePool(const ImagePool&) = delete;
+    ImagePool& operator=(const ImagePool&) = delete;
+
+    void* Allocate(size_t size);
+    void Free(void* data);
+
+    // Returns every free block to the heap. Blocks still in use stay with the pool.
+    void Trim();
+
+    // Trims the pool and destroys it.
+    void Release();
+
+private:
+    SDL_Mutex* _mutex;
+    void* _freeBlocks[SizeClassCount] = {};
+};
+
+// Owns decoded pixels and hands them back to the allocator hooks when destroyed.
 struct Image
 {
     void* Data;
@@ -126,10 +929,45 @@ struct Image
     uint32_t Channels;
 
     Image(void* data, uint32_t width, uint32_t height, uint32_t channels);
+    Image(Image&& other) noexcept;
+    Image& operator=(Image&& other) noexcept;
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
     ~Image();
 };
 
-Image* LoadImage(const std::string& filePath);
+// Loads images with all of their memory, decoded pixels and stb_image's scratch buffers
+// alike, coming from a pool it owns. The pool lives until Release, so load everything
+// through one loader and release it together with the other resources.
+class ImageLoader
+{
+public:
+    // Decodes an image into exactly the layout of format, which is either R8G8B8A8_UNORM or
+    // R8_UNORM, whatever channels the file has. Gray images are spread to RGBA, RGB and RGBA
+    // images are reduced to luminance for R8. Alpha is premultiplied on request.
+    std::optional<Image> Load(const std::string& filePath, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, bool premultiplyAlpha = false);
+
+    // Decodes the images like Load on up to threadCount threads and returns them in the order
+    // of filePaths once all are done. Images that fail to load are std::nullopt.
+    std::vector<std::optional<Image>> LoadMany(const std::vector<std::string>& filePaths, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, bool premultiplyAlpha = false, uint32_t threadCount = 0);
+
+    // Starts decoding the images like Load on a background worker pool and returns right away.
+    // Each future becomes ready as soon as its own image is decoded.
+    std::vector<std::future<std::optional<Image>>> LoadManyAsync(const std::vector<std::string>& filePaths, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, bool premultiplyAlpha = false, uint32_t threadCount = 0);
+
+    // Hands the memory of destroyed images back to the heap, once loading is done for a while.
+    void Trim();
+
+    // Waits for the background loads and releases the pool. Every image must be destroyed first.
+    void Release();
+
+private:
+    ImagePool _pool;
+    std::vector<SDL_Thread*> _threads;
+};
+
+// Decodes one image straight from the heap, without a pool to reuse its memory.
+std::optional<Image> LoadImage(const std::string& filePath, SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM, bool premultiplyAlpha = false);
 
 struct Time
 {
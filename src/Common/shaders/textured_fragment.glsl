@@ -0,0 +1,26 @@
+#version 460 core
+// Features: VERTEX_COLOR, TEXTURE_MIX
+// VERTEX_COLOR only matches the interface of vertex shaders that pass a colour, which the
+// textured examples receive but never apply.
+#ifdef VERTEX_COLOR
+layout (location = 0) in vec3 VertexColor;
+layout (location = 1) in vec2 TexCoord;
+#else
+layout (location = 0) in vec2 TexCoord;
+#endif
+
+layout (location = 0) out vec4 FragColor;
+
+layout (set = 2, binding = 0) uniform sampler2D containerTexture;
+#ifdef TEXTURE_MIX
+layout (set = 2, binding = 1) uniform sampler2D awesomefaceTexture;
+#endif
+
+void main()
+{
+#ifdef TEXTURE_MIX
+    FragColor = mix(texture(containerTexture, TexCoord), texture(awesomefaceTexture, TexCoord), 0.2f);
+#else
+    FragColor = texture(containerTexture, TexCoord);
+#endif
+}
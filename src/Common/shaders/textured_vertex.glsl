@@ -0,0 +1,43 @@
+#version 460 core
+// Features: VERTEX_COLOR, TRANSFORM, MODEL_VIEW_PROJECTION
+layout (location = 0) in vec3 aPos;
+
+#ifdef VERTEX_COLOR
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in vec2 aTexCoord;
+
+layout (location = 0) out vec3 VertexColor;
+layout (location = 1) out vec2 TexCoord;
+#else
+layout (location = 1) in vec2 aTexCoord;
+
+layout (location = 0) out vec2 TexCoord;
+#endif
+
+#if defined(TRANSFORM)
+layout (set = 1, binding = 0) uniform UniformBlock {
+	mat4 Transform;
+};
+#elif defined(MODEL_VIEW_PROJECTION)
+layout (set = 1, binding = 0) uniform MatrixUniform {
+	mat4 Model;
+	mat4 View;
+	mat4 Projection;
+};
+#endif
+
+void main()
+{
+#if defined(TRANSFORM)
+	gl_Position = Transform * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+#elif defined(MODEL_VIEW_PROJECTION)
+	gl_Position = Projection * View * Model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+#else
+	gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);
+#endif
+
+#ifdef VERTEX_COLOR
+	VertexColor = aColor;
+#endif
+	TexCoord = aTexCoord;
+}
@@ -1,2 +1,10 @@
+#include "misc.h"
+
+// Decoded pixels and stb's scratch buffers come from the pool of the ImageLoader that is
+// loading on the calling thread.
+#define STBI_MALLOC(size) AllocateImageMemory(size)
+#define STBI_REALLOC(data, size) ReallocateImageMemory(data, size)
+#define STBI_FREE(data) FreeImageMemory(data)
+
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
\ No newline at end of file
+#include "stb_image.h"
@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <cmath>
+#include "BlockCompression.h"
+#include "Common/misc.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define BLOCK_COMPRESSION_NEON
+#include <arm_neon.h>
+#endif
+
+static const uint32_t BlockExtent = 4;
+static const uint32_t BlockTexels = BlockExtent * BlockExtent;
+
+static const uint8_t Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+bool IsBlockCompressionFormat(SDL_GPUTextureFormat format)
+{
+    return format == SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM
+        || format == SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM
+        || format == SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+}
+
+// Dot product of every texel of a block with axis, whose components must fit into 16 bits.
+static void ProjectBlock(const uint8_t* texels, const int16_t axis[4], int32_t* dots)
+{
+#if defined(BLOCK_COMPRESSION_SSE2)
+    __m128i zero = _mm_setzero_si128();
+    __m128i axes = _mm_setr_epi16(axis[0], axis[1], axis[2], axis[3], axis[0], axis[1], axis[2], axis[3]);
+
+    for (uint32_t i = 0; i < BlockTexels; i += 4)
+    {
+        __m128i quad = _mm_loadu_si128((const __m128i*) (texels + i * 4));
+
+        // Red and green, then blue and alpha of two texels per register.
+        __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(quad, zero), axes);
+        __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(quad, zero), axes);
+
+        low = _mm_add_epi32(low, _mm_srli_epi64(low, 32));
+        high = _mm_add_epi32(high, _mm_srli_epi64(high, 32));
+
+        __m128i sums = _mm_unpacklo_epi64(_mm_shuffle_epi32(low, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storeu_si128((__m128i*) (dots + i), sums);
+    }
+#elif defined(BLOCK_COMPRESSION_NEON)
+    int16x4_t axes = vld1_s16(axis);
+
+    for (uint32_t i = 0; i < BlockTexels; i += 4)
+    {
+        uint8x16_t quad = vld1q_u8(texels + i * 4);
+        int16x8_t low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(quad)));
+        int16x8_t high = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(quad)));
+
+        int32x4_t first = vpaddq_s32(vmull_s16(vget_low_s16(low), axes), vmull_s16(vget_high_s16(low), axes));
+        int32x4_t second = vpaddq_s32(vmull_s16(vget_low_s16(high), axes), vmull_s16(vget_high_s16(high), axes));
+
+        vst1q_s32(dots + i, vpaddq_s32(first, second));
+    }
+#else
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        const uint8_t* texel = texels + i * 4;
+        dots[i] = texel[0] * axis[0] + texel[1] * axis[1] + texel[2] * axis[2] + texel[3] * axis[3];
+    }
+#endif
+}
+
+static void FetchBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* texels)
+{
+    uint32_t x = blockX * BlockExtent;
+    uint32_t y = blockY * BlockExtent;
+
+    if (x + BlockExtent <= width && y + BlockExtent <= height)
+    {
+        for (uint32_t row = 0; row < BlockExtent; row++)
+        {
+            SDL_memcpy(texels + row * BlockExtent * 4, pixels + ((y + row) * width + x) * 4, BlockExtent * 4);
+        }
+
+        return;
+    }
+
+    for (uint32_t row = 0; row < BlockExtent; row++)
+    {
+        uint32_t sourceY = std::min(y + row, height - 1);
+
+        for (uint32_t column = 0; column < BlockExtent; column++)
+        {
+            uint32_t sourceX = std::min(x + column, width - 1);
+            SDL_memcpy(texels + (row * BlockExtent + column) * 4, pixels + (sourceY * width + sourceX) * 4, 4);
+        }
+    }
+}
+
+// Direction in which the texels spread the most, found by power iteration on their
+// covariance and scaled so its largest component is 255. Zero for flat blocks.
+static void FindPrincipalAxis(const uint8_t* texels, uint32_t channelCount, int16_t axis[4])
+{
+    float mean[4] = {};
+
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        for (uint32_t channel = 0; channel < channelCount; channel++)
+        {
+            mean[channel] += texels[i * 4 + channel] / (float) BlockTexels;
+        }
+    }
+
+    float covariance[4][4] = {};
+
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        for (uint32_t a = 0; a < channelCount; a++)
+        {
+            for (uint32_t b = 0; b < channelCount; b++)
+            {
+                covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+            }
+        }
+    }
+
+    uint32_t widestChannel = 0;
+
+    for (uint32_t channel = 1; channel < channelCount; channel++)
+    {
+        if (covariance[channel][channel] > covariance[widestChannel][widestChannel])
+        {
+            widestChannel = channel;
+        }
+    }
+
+    float vector[4] = {};
+    float largest = 0;
+
+    for (uint32_t channel = 0; channel < channelCount; channel++)
+    {
+        vector[channel] = covariance[widestChannel][channel];
+    }
+
+    for (uint32_t iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        largest = 0;
+
+        for (uint32_t a = 0; a < channelCount; a++)
+        {
+            for (uint32_t b = 0; b < channelCount; b++)
+            {
+                next[a] += covariance[a][b] * vector[b];
+            }
+
+            largest = std::max(largest, std::abs(next[a]));
+        }
+
+        if (largest == 0)
+        {
+            break;
+        }
+
+        for (uint32_t channel = 0; channel < channelCount; channel++)
+        {
+            vector[channel] = next[channel] / largest;
+        }
+    }
+
+    for (uint32_t channel = 0; channel < 4; channel++)
+    {
+        axis[channel] = largest == 0 ? 0 : (int16_t) (vector[channel] * 255.0f);
+    }
+}
+
+// Texels at both ends of the axis, moved inwards by a sixteenth of their distance, which
+// lowers the error of the texels in between.
+static void FindEndpoints(const uint8_t* texels, const int16_t axis[4], uint8_t low[4], uint8_t high[4])
+{
+    int32_t dots[BlockTexels];
+    ProjectBlock(texels, axis, dots);
+
+    uint32_t lowIndex = 0;
+    uint32_t highIndex = 0;
+
+    for (uint32_t i = 1; i < BlockTexels; i++)
+    {
+        lowIndex = dots[i] < dots[lowIndex] ? i : lowIndex;
+        highIndex = dots[i] > dots[highIndex] ? i : highIndex;
+    }
+
+    for (uint32_t channel = 0; channel < 4; channel++)
+    {
+        int32_t lowValue = texels[lowIndex * 4 + channel];
+        int32_t highValue = texels[highIndex * 4 + channel];
+        int32_t inset = (highValue - lowValue) / 16;
+
+        low[channel] = (uint8_t) (lowValue + inset);
+        high[channel] = (uint8_t) (highValue - inset);
+    }
+}
+
+// Position of every texel between from and to, from 0 at from to steps at to.
+static void FitIndices(const uint8_t* texels, const int32_t from[4], const int32_t to[4], uint32_t steps, float* positions)
+{
+    int16_t direction[4];
+    int32_t base = 0;
+    int32_t length = 0;
+
+    for (uint32_t channel = 0; channel < 4; channel++)
+    {
+        direction[channel] = (int16_t) (to[channel] - from[channel]);
+        base += from[channel] * direction[channel];
+        length += direction[channel] * direction[channel];
+    }
+
+    int32_t dots[BlockTexels];
+    ProjectBlock(texels, direction, dots);
+
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        positions[i] = length == 0 ? 0 : std::clamp((dots[i] - base) / (float) length, 0.0f, 1.0f) * steps;
+    }
+}
+
+static uint16_t PackRgb565(const uint8_t color[4])
+{
+    return (uint16_t) (((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | (color[2] * 31 + 127) / 255);
+}
+
+static void UnpackRgb565(uint16_t packed, int32_t color[4])
+{
+    uint32_t red = packed >> 11;
+    uint32_t green = (packed >> 5) & 63;
+    uint32_t blue = packed & 31;
+
+    color[0] = red << 3 | red >> 2;
+    color[1] = green << 2 | green >> 4;
+    color[2] = blue << 3 | blue >> 2;
+    color[3] = 0;
+}
+
+// BC1 colour block. With punch-through alpha, texels below half opacity are stored as
+// transparent black using the three colour mode.
+static void EncodeColorBlock(const uint8_t* texels, bool hasPunchThroughAlpha, uint8_t* block)
+{
+    // BC1 without alpha only spans red, green and blue.
+    uint8_t opaqueTexels[BlockTexels * 4];
+    bool isTransparent = false;
+
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        SDL_memcpy(opaqueTexels + i * 4, texels + i * 4, 3);
+        opaqueTexels[i * 4 + 3] = 0;
+        isTransparent |= hasPunchThroughAlpha && texels[i * 4 + 3] < 128;
+    }
+
+    int16_t axis[4];
+    uint8_t low[4], high[4];
+
+    FindPrincipalAxis(opaqueTexels, 3, axis);
+    FindEndpoints(opaqueTexels, axis, low, high);
+
+    uint16_t color0 = PackRgb565(high);
+    uint16_t color1 = PackRgb565(low);
+
+    // Four colour blocks need color0 above color1, three colour blocks the opposite.
+    if (isTransparent ? color0 > color1 : color0 < color1)
+    {
+        std::swap(color0, color1);
+    }
+
+    int32_t from[4], to[4];
+    UnpackRgb565(color0, from);
+    UnpackRgb565(color1, to);
+
+    float positions[BlockTexels];
+    FitIndices(opaqueTexels, from, to, isTransparent ? 2 : 3, positions);
+
+    // Palette order is color0, color1, then the interpolated colours nearest to color0.
+    static const uint32_t FourColorIndices[4] = { 0, 2, 3, 1 };
+    static const uint32_t ThreeColorIndices[3] = { 0, 2, 1 };
+
+    uint32_t indices = 0;
+
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        uint32_t step = (uint32_t) (positions[i] + 0.5f);
+        uint32_t index = isTransparent ? ThreeColorIndices[step] : FourColorIndices[step];
+
+        if (isTransparent && texels[i * 4 + 3] < 128)
+        {
+            index = 3;
+        }
+
+        indices |= index << (i * 2);
+    }
+
+    // Blocks of a color0 equal to color1 decode as the three colour mode, which still
+    // reproduces color0 for every opaque texel.
+    if (color0 == color1 && !isTransparent)
+    {
+        indices = 0;
+    }
+
+    block[0] = (uint8_t) color0;
+    block[1] = (uint8_t) (color0 >> 8);
+    block[2] = (uint8_t) color1;
+    block[3] = (uint8_t) (color1 >> 8);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        block[4 + i] = (uint8_t) (indices >> (i * 8));
+    }
+}
+
+// BC4 block of the alpha channel, as used by BC3, always in the eight value mode.
+static void EncodeAlphaBlock(const uint8_t* texels, uint8_t* block)
+{
+    uint8_t lowest = 255;
+    uint8_t highest = 0;
+
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        lowest = std::min(lowest, texels[i * 4 + 3]);
+        highest = std::max(highest, texels[i * 4 + 3]);
+    }
+
+    uint64_t indices = 0;
+
+    if (highest > lowest)
+    {
+        int32_t range = highest - lowest;
+
+        for (uint32_t i = 0; i < BlockTexels; i++)
+        {
+            // Seven steps from lowest, stored as 1, then 7 down to 2, then 0 for highest.
+            uint32_t step = ((texels[i * 4 + 3] - lowest) * 14 + range) / (2 * range);
+            uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+
+            indices |= index << (i * 3);
+        }
+    }
+
+    block[0] = highest;
+    block[1] = lowest;
+
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        block[2 + i] = (uint8_t) (indices >> (i * 8));
+    }
+}
+
+// Picks the p-bit shared by all channels of an endpoint that keeps its seven bit
+// channels closest to color.
+static void QuantizeBc7Endpoint(const uint8_t color[4], uint8_t quantized[4], uint32_t& pBit)
+{
+    uint32_t bestError = UINT32_MAX;
+
+    for (uint32_t candidateBit = 0; candidateBit < 2; candidateBit++)
+    {
+        uint8_t candidate[4];
+        uint32_t error = 0;
+
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            candidate[channel] = (uint8_t) std::min((color[channel] - (int32_t) candidateBit + 1) >> 1, 127);
+
+            int32_t difference = (candidate[channel] << 1 | candidateBit) - color[channel];
+            error += difference * difference;
+        }
+
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = candidateBit;
+            SDL_memcpy(quantized, candidate, 4);
+        }
+    }
+}
+
+struct BlockBitWriter
+{
+    uint8_t* Block;
+    uint32_t Position = 0;
+
+    void Write(uint32_t value, uint32_t bitCount)
+    {
+        for (uint32_t bit = 0; bit < bitCount; bit++, Position++)
+        {
+            Block[Position / 8] |= (uint8_t) (((value >> bit) & 1) << (Position % 8));
+        }
+    }
+};
+
+// BC7 mode 6, one subset with seven bit RGBA endpoints, a p-bit each and four bit indices.
+static void EncodeBc7Block(const uint8_t* texels, uint8_t* block)
+{
+    int16_t axis[4];
+    uint8_t low[4], high[4];
+
+    FindPrincipalAxis(texels, 4, axis);
+    FindEndpoints(texels, axis, low, high);
+
+    uint8_t endpoints[2][4];
+    uint32_t pBits[2];
+
+    QuantizeBc7Endpoint(low, endpoints[0], pBits[0]);
+    QuantizeBc7Endpoint(high, endpoints[1], pBits[1]);
+
+    int32_t from[4], to[4];
+
+    for (uint32_t channel = 0; channel < 4; channel++)
+    {
+        from[channel] = endpoints[0][channel] << 1 | pBits[0];
+        to[channel] = endpoints[1][channel] << 1 | pBits[1];
+    }
+
+    float positions[BlockTexels];
+    FitIndices(texels, from, to, 64, positions);
+
+    uint32_t indices[BlockTexels];
+
+    for (uint32_t i = 0; i < BlockTexels; i++)
+    {
+        // The weights are almost evenly spaced, so only the neighbours of the even guess can be closer.
+        uint32_t guess = std::min((uint32_t) (positions[i] * 15 / 64 + 0.5f), 15u);
+        uint32_t best = guess;
+
+        for (uint32_t candidate = guess > 0 ? guess - 1 : 0; candidate <= std::min(guess + 1, 15u); candidate++)
+        {
+            if (std::abs(Bc7Weights[candidate] - positions[i]) < std::abs(Bc7Weights[best] - positions[i]))
+            {
+                best = candidate;
+            }
+        }
+
+        indices[i] = best;
+    }
+
+    // The first index is stored without its top bit, which flipping the endpoints clears.
+    if (indices[0] >= 8)
+    {
+        std::swap(endpoints[0], endpoints[1]);
+        std::swap(pBits[0], pBits[1]);
+
+        for (uint32_t& index : indices)
+        {
+            index = 15 - index;
+        }
+    }
+
+    SDL_memset(block, 0, 16);
+    BlockBitWriter writer{ .Block = block };
+
+    writer.Write(1 << 6, 7);
+
+    for (uint32_t channel = 0; channel < 4; channel++)
+    {
+        writer.Write(endpoints[0][channel], 7);
+        writer.Write(endpoints[1][channel], 7);
+    }
+
+    writer.Write(pBits[0], 1);
+    writer.Write(pBits[1], 1);
+    writer.Write(indices[0], 3);
+
+    for (uint32_t i = 1; i < BlockTexels; i++)
+    {
+        writer.Write(indices[i], 4);
+    }
+}
+
+void CompressImage(const uint8_t* pixels, uint32_t width, uint32_t height, SDL_GPUTextureFormat format, uint8_t* blocks)
+{
+    uint32_t blocksPerRow = (width + BlockExtent - 1) / BlockExtent;
+    uint32_t blockRows = (height + BlockExtent - 1) / BlockExtent;
+    uint32_t blockSize = SDL_GPUTextureFormatTexelBlockSize(format);
+
+    ParallelFor(blockRows, [&](size_t blockRow)
+    {
+        uint8_t texels[BlockTexels * 4];
+
+        for (uint32_t blockColumn = 0; blockColumn < blocksPerRow; blockColumn++)
+        {
+            uint8_t* block = blocks + (blockRow * blocksPerRow + blockColumn) * blockSize;
+
+            FetchBlock(pixels, width, height, blockColumn, (uint32_t) blockRow, texels);
+
+            switch (format)
+            {
+            case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+                EncodeColorBlock(texels, true, block);
+                break;
+            case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+                EncodeAlphaBlock(texels, block);
+                EncodeColorBlock(texels, false, block + 8);
+                break;
+            case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+                EncodeBc7Block(texels, block);
+                break;
+            default:
+                break;
+            }
+        }
+    });
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+#include <SDL3/SDL.h>
+
+bool IsBlockCompressionFormat(SDL_GPUTextureFormat format);
+
+// Encodes one RGBA8 image into BC1, BC3 or BC7 blocks, spread over worker threads. Edge
+// blocks of images whose size is not a multiple of four repeat the last row and column.
+// BC1 keeps one bit of alpha, BC3 and BC7 keep all of it.
+void CompressImage(const uint8_t* pixels, uint32_t width, uint32_t height, SDL_GPUTextureFormat format, uint8_t* blocks);
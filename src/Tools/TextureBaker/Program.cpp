@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <vector>
+#include "SDL3/SDL.h"
+#include "Common/misc.h"
+#include "stb_image.h"
+#include "BlockCompression.h"
+
+// Bakes images into the container read by LoadBakedTexture, so the examples skip decoding,
+// flipping and mip generation at startup.
+// Usage: TextureBaker [--format auto|rgba8|bc1|bc3|bc7] <input image> <output file>
+// The auto format picks BC1 for opaque images and BC7 for images with alpha. Block-compressed
+// textures also get an RGBA8 copy at GetBakedTextureFallbackPath for GPUs without BC support.
+
+static const uint32_t BakedChannels = 4;
+
+// Averages 2x2 texels of the previous mip. Odd edges reuse the last row or column.
+static void DownsampleMip(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination)
+{
+    uint32_t width = std::max(sourceWidth >> 1, 1u);
+    uint32_t height = std::max(sourceHeight >> 1, 1u);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint32_t y0 = std::min(y * 2, sourceHeight - 1);
+        uint32_t y1 = std::min(y * 2 + 1, sourceHeight - 1);
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t x0 = std::min(x * 2, sourceWidth - 1);
+            uint32_t x1 = std::min(x * 2 + 1, sourceWidth - 1);
+
+            for (uint32_t channel = 0; channel < BakedChannels; channel++)
+            {
+                uint32_t sum = source[(y0 * sourceWidth + x0) * BakedChannels + channel]
+                    + source[(y0 * sourceWidth + x1) * BakedChannels + channel]
+                    + source[(y1 * sourceWidth + x0) * BakedChannels + channel]
+                    + source[(y1 * sourceWidth + x1) * BakedChannels + channel];
+
+                destination[(y * width + x) * BakedChannels + channel] = (uint8_t) ((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static std::optional<SDL_GPUTextureFormat> ParseFormat(const std::string& name, bool hasAlpha)
+{
+    if (name == "auto")
+    {
+        return hasAlpha ? SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM : SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+    }
+
+    if (name == "rgba8")
+    {
+        return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    }
+
+    if (name == "bc1")
+    {
+        return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+    }
+
+    if (name == "bc3")
+    {
+        return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+    }
+
+    if (name == "bc7")
+    {
+        return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+    }
+
+    return std::nullopt;
+}
+
+static bool HasAlpha(const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+    for (uint64_t i = 0; i < (uint64_t) width * height; i++)
+    {
+        if (pixels[i * BakedChannels + 3] != 255)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool WriteBakedTexture(const std::string& path, SDL_GPUTextureFormat format, uint32_t width, uint32_t height, uint32_t levelCount, const std::vector<uint8_t>& mipChain)
+{
+    BakedTextureHeader header = {
+        .Magic = BakedTextureHeader::ExpectedMagic,
+        .Version = BakedTextureHeader::CurrentVersion,
+        .Format = (uint32_t) format,
+        .Width = width,
+        .Height = height,
+        .LevelCount = levelCount,
+        .DataSize = mipChain.size(),
+    };
+
+    SDL_IOStream* output = SDL_IOFromFile(path.c_str(), "wb");
+
+    if (output == NULL)
+    {
+        SDL_Log("Failed to open %s: %s", path.c_str(), SDL_GetError());
+        return false;
+    }
+
+    bool isWritten = SDL_WriteIO(output, &header, sizeof(header)) == sizeof(header)
+        && SDL_WriteIO(output, mipChain.data(), mipChain.size()) == mipChain.size();
+
+    if (!SDL_CloseIO(output) || !isWritten)
+    {
+        SDL_Log("Failed to write %s: %s", path.c_str(), SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string formatName = "auto";
+
+    if (argc == 5 && std::string(argv[1]) == "--format")
+    {
+        formatName = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc != 3)
+    {
+        SDL_Log("Usage: TextureBaker [--format auto|rgba8|bc1|bc3|bc7] <input image> <output file>");
+        return -1;
+    }
+
+    // Rows are stored flipped the same way LoadImage flips them.
+    stbi_set_flip_vertically_on_load(true);
+
+    int32_t width, height, channels;
+    uint8_t* pixels = stbi_load(argv[1], &width, &height, &channels, BakedChannels);
+
+    if (pixels == NULL)
+    {
+        SDL_Log("Failed to load image %s: %s", argv[1], stbi_failure_reason());
+        return -1;
+    }
+
+    std::optional<SDL_GPUTextureFormat> bakedFormat = ParseFormat(formatName, HasAlpha(pixels, width, height));
+
+    if (bakedFormat == std::nullopt)
+    {
+        SDL_Log("Unknown texture format %s", formatName.c_str());
+        stbi_image_free(pixels);
+        return -1;
+    }
+
+    // Mips are generated in RGBA8 and compressed one by one afterwards.
+    SDL_GPUTextureFormat format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    uint32_t levelCount = GetMipLevelCount(width, height);
+
+    // Block-compressed textures need a top mip of whole blocks on every backend.
+    if (IsBlockCompressionFormat(*bakedFormat) && (width % 4 != 0 || height % 4 != 0))
+    {
+        SDL_Log("%s is %dx%d, which is not a multiple of 4, keeping it uncompressed", argv[1], width, height);
+        bakedFormat = format;
+    }
+
+    std::vector<uint8_t> mipChain(GetMipChainSize(format, width, height, levelCount));
+    SDL_memcpy(mipChain.data(), pixels, GetTextureSubresourceSize(format, width, height));
+
+    stbi_image_free(pixels);
+
+    uint8_t* mip = mipChain.data();
+
+    for (uint32_t mipLevel = 1; mipLevel < levelCount; mipLevel++)
+    {
+        uint32_t mipWidth = std::max((uint32_t) width >> (mipLevel - 1), 1u);
+        uint32_t mipHeight = std::max((uint32_t) height >> (mipLevel - 1), 1u);
+        uint8_t* nextMip = mip + GetTextureSubresourceSize(format, mipWidth, mipHeight);
+
+        DownsampleMip(mip, mipWidth, mipHeight, nextMip);
+
+        mip = nextMip;
+    }
+
+    if (!IsBlockCompressionFormat(*bakedFormat))
+    {
+        return WriteBakedTexture(argv[2], format, width, height, levelCount, mipChain) ? 0 : -1;
+    }
+
+    std::vector<uint8_t> compressedChain(GetMipChainSize(*bakedFormat, width, height, levelCount));
+    const uint8_t* source = mipChain.data();
+    uint8_t* destination = compressedChain.data();
+
+    for (uint32_t mipLevel = 0; mipLevel < levelCount; mipLevel++)
+    {
+        uint32_t mipWidth = std::max((uint32_t) width >> mipLevel, 1u);
+        uint32_t mipHeight = std::max((uint32_t) height >> mipLevel, 1u);
+
+        CompressImage(source, mipWidth, mipHeight, *bakedFormat, destination);
+
+        source += GetTextureSubresourceSize(format, mipWidth, mipHeight);
+        destination += GetTextureSubresourceSize(*bakedFormat, mipWidth, mipHeight);
+    }
+
+    if (!WriteBakedTexture(argv[2], *bakedFormat, width, height, levelCount, compressedChain)
+        || !WriteBakedTexture(GetBakedTextureFallbackPath(argv[2]), format, width, height, levelCount, mipChain))
+    {
+        return -1;
+    }
+
+    return 0;
+}